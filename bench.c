@@ -0,0 +1,565 @@
+// Build: gcc -std=c11 -O2 -o bench bench.c
+//
+// Throughput benchmark for simulation. Generates traces with tracegen, replays
+// them across RAM sizes and process counts, and reports requests per second,
+// ns per request, peak RSS and fault counts, each the best of several runs.
+// The results are compared with a stored baseline, and the in.txt -> out.txt
+// golden case is checked first. Exits with failure on any regression.
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define MAX_LIST_VALUES 16
+#define MAX_BASELINE 1024
+#define PAGES_PER_PROCESS 1024
+#define TOLERANCE 0.25              // allowed slowdown or RSS growth over the baseline
+#define STREAM_ABOVE 100000000LL    // larger traces are piped from tracegen instead of stored
+#define MIN_TIMED_SECONDS 0.05      // shorter runs are too coarse for the rusage clock to judge speed
+#define REPEAT 3                    // runs per case; the fastest is kept
+
+// One benchmark run and what it measured
+typedef struct bench_result
+{
+    long long requests;
+    int ram_size;
+    int processes;
+    double seconds;           // user + system time of the simulator alone, best of the repeats
+    long peak_rss_kb;
+    long faults;
+    int failed;
+} bench_result;
+
+// Settings shared by every run
+typedef struct bench_config
+{
+    const char *simulation;
+    const char *tracegen;
+    const char *work_dir;
+    const char *pattern;
+    const char *policy;
+    int pages;
+    long long stream_above;
+    int repeat;
+} bench_config;
+
+// Function to parse a comma separated list of positive integers; returns the count or -1
+static int parse_int_list(const char *arg, int *values, int max_values) {
+    int count = 0;
+    const char *p = arg;
+    while (*p) {
+        char *end;
+        long value = strtol(p, &end, 10);
+        if (end == p || value < 1 || count == max_values || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        values[count++] = (int)value;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+// Function to start a program with its standard input and output redirected; returns its pid or -1
+static pid_t spawn(char *const argv[], int input_fd, int output_fd) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (input_fd != -1) {
+            dup2(input_fd, STDIN_FILENO);
+        }
+        if (output_fd != -1) {
+            dup2(output_fd, STDOUT_FILENO);
+        }
+        execv(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+    return pid;
+}
+
+// Function to wait for a child; returns 0 if it exited cleanly, with its resource usage in *usage
+static int wait_child(pid_t pid, struct rusage *usage) {
+    int status;
+    struct rusage ignored;
+    if (wait4(pid, &status, 0, usage ? usage : &ignored) != pid) {
+        return -1;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+// Function to compare two files byte for byte; returns 0 when they are identical
+static int same_file(const char *a, const char *b) {
+    FILE *fa = fopen(a, "rb");
+    FILE *fb = fopen(b, "rb");
+    int same = fa != NULL && fb != NULL;
+    while (same) {
+        int ca = fgetc(fa);
+        int cb = fgetc(fb);
+        same = ca == cb;
+        if (ca == EOF || cb == EOF) {
+            break;
+        }
+    }
+    if (fa) {
+        fclose(fa);
+    }
+    if (fb) {
+        fclose(fb);
+    }
+    return same ? 0 : -1;
+}
+
+// Function to run the golden case and compare it with the expected output
+static int check_golden(const bench_config *cfg, const char *input, const char *expected) {
+    char output[4096];
+    snprintf(output, sizeof(output), "%s/bench_golden.txt", cfg->work_dir);
+    char *argv[] = { (char *)cfg->simulation, (char *)input, output, NULL };
+    pid_t pid = spawn(argv, -1, -1);
+    if (pid == -1 || wait_child(pid, NULL) != 0) {
+        return -1;
+    }
+    return same_file(output, expected);
+}
+
+// Function to name the stored trace for a request count and process count
+static void trace_path(const bench_config *cfg, long long requests, int processes, char *path, size_t size) {
+    snprintf(path, size, "%s/bench_%s_%lld_%d_%d.txt", cfg->work_dir, cfg->pattern, requests, processes, cfg->pages);
+}
+
+// Fill in the tracegen command line for a trace; the strings live in the caller's buffers
+static void tracegen_argv(const bench_config *cfg, long long requests, int processes, const char *output,
+                          char *requests_arg, char *processes_arg, char *pages_arg, char **argv) {
+    sprintf(requests_arg, "%lld", requests);
+    sprintf(processes_arg, "%d", processes);
+    sprintf(pages_arg, "%d", cfg->pages);
+    char **a = argv;
+    *a++ = (char *)cfg->tracegen;
+    *a++ = (char *)cfg->pattern;
+    *a++ = requests_arg;
+    *a++ = (char *)output;
+    *a++ = "--processes";
+    *a++ = processes_arg;
+    *a++ = "--pages";
+    *a++ = pages_arg;
+    *a++ = "--seed";
+    *a++ = "1";
+    *a = NULL;
+}
+
+// Function to check that a stored trace's tracegen header names the wanted parameters
+static int trace_matches(const bench_config *cfg, long long requests, int processes, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+    char header[1024], expected[512];
+    int found = fgets(header, sizeof(header), f) != NULL;
+    fclose(f);
+    snprintf(expected, sizeof(expected), "# tracegen %s requests=%lld processes=%d pages=%d seed=1 ",
+             cfg->pattern, requests, processes, cfg->pages);
+    return found && strncmp(header, expected, strlen(expected)) == 0;
+}
+
+// Function to generate a stored trace unless an earlier run left a matching one; returns -1 on failure
+static int ensure_trace(const bench_config *cfg, long long requests, int processes) {
+    char path[4096], temporary[4200];
+    trace_path(cfg, requests, processes, path, sizeof(path));
+    // The work directory is shared, so a file of the right name may come from another tool or version
+    if (trace_matches(cfg, requests, processes, path)) {
+        return 0;
+    }
+
+    // Written under another name first, so an interrupted run never leaves a short trace behind
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    char requests_arg[32], processes_arg[32], pages_arg[32];
+    char *argv[12];
+    tracegen_argv(cfg, requests, processes, temporary, requests_arg, processes_arg, pages_arg, argv);
+    pid_t pid = spawn(argv, -1, -1);
+    if (pid == -1 || wait_child(pid, NULL) != 0 || rename(temporary, path) != 0) {
+        remove(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to read the total fault count from the final row of a statistics file; -1 if missing
+static long read_faults(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return -1;
+    }
+    char line[1024];
+    long faults = -1;
+    while (fgets(line, sizeof(line), f)) {
+        long hits, count;
+        if (strncmp(line, "final,", 6) == 0 && strstr(line, ",all,") &&
+            sscanf(strstr(line, ",all,") + 5, "%ld,%ld", &hits, &count) == 2) {
+            faults = count;
+        }
+    }
+    fclose(f);
+    return faults;
+}
+
+// Function to replay one trace through the simulator once and measure it
+static void run_once(const bench_config *cfg, bench_result *result) {
+    char trace[4096], stats[4096];
+    char ram_arg[32], processes_arg[32], pages_arg[32];
+    trace_path(cfg, result->requests, result->processes, trace, sizeof(trace));
+    snprintf(stats, sizeof(stats), "%s/bench_stats.csv", cfg->work_dir);
+    sprintf(ram_arg, "%d", result->ram_size);
+    sprintf(processes_arg, "%d", result->processes);
+    sprintf(pages_arg, "%d", cfg->pages);
+
+    int streamed = result->requests > cfg->stream_above;
+    char *argv[] = { (char *)cfg->simulation, "--trace-format", "records", "--processes", processes_arg,
+                     "--pages", pages_arg, "--ram", ram_arg, "--policy", (char *)cfg->policy,
+                     "--stats", stats, streamed ? "-" : trace, "/dev/null", NULL };
+
+    // Huge traces stream from tracegen; timing the simulator's own CPU time keeps the pipe out of it
+    pid_t generator = -1;
+    int pipe_fds[2] = { -1, -1 };
+    if (streamed) {
+        char requests_arg[32], generator_processes[32], generator_pages[32];
+        char *generator_argv[12];
+        tracegen_argv(cfg, result->requests, result->processes, "-", requests_arg, generator_processes,
+                      generator_pages, generator_argv);
+        if (pipe(pipe_fds) != 0) {
+            result->failed = 1;
+            return;
+        }
+        generator = spawn(generator_argv, -1, pipe_fds[1]);
+        close(pipe_fds[1]);
+    }
+
+    struct rusage usage;
+    pid_t pid = spawn(argv, pipe_fds[0], -1);
+    if (streamed) {
+        close(pipe_fds[0]);
+    }
+    result->failed = pid == -1 || wait_child(pid, &usage) != 0;
+    if (generator != -1 && wait_child(generator, NULL) != 0) {
+        result->failed = 1;
+    }
+    if (result->failed) {
+        return;
+    }
+    result->seconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                      usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    result->peak_rss_kb = usage.ru_maxrss;
+    result->faults = read_faults(stats);
+    result->failed = result->faults < 0;
+}
+
+// Function to measure a case cfg->repeat times, keeping the fastest run and the smallest peak RSS.
+// The machine's noise only ever adds time, so the minimum is the most repeatable figure.
+static void run_case(const bench_config *cfg, bench_result *result) {
+    bench_result best = *result;
+    for (int i = 0; i < cfg->repeat; i++) {
+        bench_result run = *result;
+        run_once(cfg, &run);
+        if (run.failed || (i > 0 && run.faults != best.faults)) {
+            result->failed = 1;  // A simulation that changes between runs cannot be judged
+            return;
+        }
+        if (i == 0 || run.seconds < best.seconds) {
+            best.seconds = run.seconds;
+        }
+        if (i == 0 || run.peak_rss_kb < best.peak_rss_kb) {
+            best.peak_rss_kb = run.peak_rss_kb;
+        }
+        best.faults = run.faults;
+    }
+    *result = best;
+}
+
+// Function to load a baseline file; returns the number of entries, 0 if there is none
+static int load_baseline(const char *path, const bench_config *cfg, bench_result *baseline) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+    char line[1024];
+    int count = 0;
+    while (count < MAX_BASELINE && fgets(line, sizeof(line), f)) {
+        char pattern[64], policy[64];
+        int pages;
+        double ns;
+        bench_result *b = &baseline[count];
+        if (line[0] == '#' ||
+            sscanf(line, "%63s %63s %d %lld %d %d %lf %ld %ld", pattern, policy, &pages, &b->requests,
+                   &b->ram_size, &b->processes, &ns, &b->peak_rss_kb, &b->faults) != 9) {
+            continue;
+        }
+        // Entries for other workloads stay in the file but are not compared
+        if (strcmp(pattern, cfg->pattern) == 0 && strcmp(policy, cfg->policy) == 0 && pages == cfg->pages) {
+            b->seconds = ns * b->requests / 1e9;
+            count++;
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+// Function to tell whether a baseline line is one of this run's cases, which replace it
+static int replaced_by_run(const char *line, const bench_config *cfg, const bench_result *results, int run_count) {
+    char pattern[64], policy[64];
+    int pages, ram_size, processes;
+    long long requests;
+    if (sscanf(line, "%63s %63s %d %lld %d %d", pattern, policy, &pages, &requests, &ram_size, &processes) != 6 ||
+        strcmp(pattern, cfg->pattern) != 0 || strcmp(policy, cfg->policy) != 0 || pages != cfg->pages) {
+        return 0;
+    }
+    for (int i = 0; i < run_count; i++) {
+        if (!results[i].failed && results[i].requests == requests && results[i].ram_size == ram_size &&
+            results[i].processes == processes) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Function to write this run's results into the baseline file; entries of other cases and
+// workloads are kept. Returns -1 on failure.
+static int write_baseline(const char *path, const bench_config *cfg, const bench_result *results, int run_count) {
+    char temporary[4200];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE *out = fopen(temporary, "w");
+    if (out == NULL) {
+        perror("Error opening baseline file");
+        return -1;
+    }
+    fprintf(out, "# pattern policy pages requests ram_size processes ns_per_request peak_rss_kb faults\n");
+
+    FILE *old = fopen(path, "r");
+    if (old != NULL) {
+        char line[1024];
+        while (fgets(line, sizeof(line), old)) {
+            if (line[0] != '#' && !replaced_by_run(line, cfg, results, run_count)) {
+                fputs(line, out);
+            }
+        }
+        fclose(old);
+    }
+    for (int i = 0; i < run_count; i++) {
+        const bench_result *res = &results[i];
+        if (!res->failed) {
+            fprintf(out, "%s %s %d %lld %d %d %.1f %ld %ld\n", cfg->pattern, cfg->policy, cfg->pages,
+                    res->requests, res->ram_size, res->processes, res->seconds * 1e9 / res->requests,
+                    res->peak_rss_kb, res->faults);
+        }
+    }
+    // Renamed into place only once complete, so a failed write leaves the old baseline intact
+    if (fclose(out) != 0 || rename(temporary, path) != 0) {
+        perror("Error writing baseline file");
+        remove(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to find the baseline entry of a run, or NULL
+static const bench_result *find_baseline(const bench_result *baseline, int count, const bench_result *r) {
+    for (int i = 0; i < count; i++) {
+        if (baseline[i].requests == r->requests && baseline[i].ram_size == r->ram_size &&
+            baseline[i].processes == r->processes) {
+            return &baseline[i];
+        }
+    }
+    return NULL;
+}
+
+// Function to judge a run against its baseline; returns a short verdict, "ok" when nothing regressed
+static const char *verdict(const bench_result *r, const bench_result *b, double tolerance) {
+    if (r->failed) {
+        return "FAILED";
+    }
+    if (b == NULL) {
+        return "new";
+    }
+    if (r->faults != b->faults) {
+        return "FAULTS-CHANGED";  // The simulation itself behaves differently
+    }
+    if (r->seconds > MIN_TIMED_SECONDS && r->seconds > b->seconds * (1.0 + tolerance)) {
+        return "SLOWER";
+    }
+    if (r->peak_rss_kb > b->peak_rss_kb * (1.0 + tolerance)) {
+        return "MORE-MEMORY";
+    }
+    return "ok";
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fprintf(stderr, "  --simulation PATH      simulator to measure (default ./simulation)\n");
+    fprintf(stderr, "  --tracegen PATH        trace generator (default ./tracegen)\n");
+    fprintf(stderr, "  --min-exp N            smallest trace, 10^N requests (default 4)\n");
+    fprintf(stderr, "  --max-exp N            largest trace, 10^N requests, up to 9 (default 6)\n");
+    fprintf(stderr, "  --ram N[,N...]         RAM sizes in slots (default 16,256,4096)\n");
+    fprintf(stderr, "  --processes N[,N...]   process counts (default 4,16,64)\n");
+    fprintf(stderr, "  --pages N              pages per process (default %d)\n", PAGES_PER_PROCESS);
+    fprintf(stderr, "  --pattern P            tracegen pattern (default zipf)\n");
+    fprintf(stderr, "  --policy P             replacement policy (default lru)\n");
+    fprintf(stderr, "  --work DIR             where traces are generated and kept (default /tmp)\n");
+    fprintf(stderr, "  --stream-above N       pipe traces longer than N requests (default %lld)\n", STREAM_ABOVE);
+    fprintf(stderr, "  --baseline FILE        results to compare with (default bench_baseline.txt)\n");
+    fprintf(stderr, "  --save-baseline        write this run's results into the baseline file, keeping other\n");
+    fprintf(stderr, "                         entries; refused if the golden case or a fault count changed\n");
+    fprintf(stderr, "  --repeat N             runs per case, the fastest is kept (default %d)\n", REPEAT);
+    fprintf(stderr, "  --tolerance F          allowed slowdown and RSS growth (default %g)\n", TOLERANCE);
+    fprintf(stderr, "  --output FILE          report file (default bench_output.txt)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bench_config cfg = { "./simulation", "./tracegen", "/tmp", "zipf", "lru", PAGES_PER_PROCESS, STREAM_ABOVE, REPEAT };
+    int ram_sizes[MAX_LIST_VALUES] = { 16, 256, 4096 };
+    int process_counts[MAX_LIST_VALUES] = { 4, 16, 64 };
+    int ram_count = 3, process_count = 3;
+    int min_exp = 4, max_exp = 6;
+    const char *baseline_path = "bench_baseline.txt";
+    const char *output_path = "bench_output.txt";
+    int save_baseline = 0;
+    double tolerance = TOLERANCE;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        char *end = NULL;
+        int ok = 1;
+        if (strcmp(arg, "--save-baseline") == 0) {
+            save_baseline = 1;
+            continue;
+        }
+        if (value == NULL) {
+            ok = 0;
+        } else if (strcmp(arg, "--simulation") == 0) {
+            cfg.simulation = value;
+        } else if (strcmp(arg, "--tracegen") == 0) {
+            cfg.tracegen = value;
+        } else if (strcmp(arg, "--min-exp") == 0) {
+            min_exp = (int)strtol(value, &end, 10);
+            ok = *end == '\0' && min_exp >= 1 && min_exp <= 9;
+        } else if (strcmp(arg, "--max-exp") == 0) {
+            max_exp = (int)strtol(value, &end, 10);
+            ok = *end == '\0' && max_exp >= 1 && max_exp <= 9;
+        } else if (strcmp(arg, "--ram") == 0) {
+            ram_count = parse_int_list(value, ram_sizes, MAX_LIST_VALUES);
+            ok = ram_count > 0;
+        } else if (strcmp(arg, "--processes") == 0) {
+            process_count = parse_int_list(value, process_counts, MAX_LIST_VALUES);
+            ok = process_count > 0;
+        } else if (strcmp(arg, "--pages") == 0) {
+            ok = parse_int_list(value, &cfg.pages, 1) == 1;
+        } else if (strcmp(arg, "--pattern") == 0) {
+            cfg.pattern = value;
+        } else if (strcmp(arg, "--policy") == 0) {
+            cfg.policy = value;
+        } else if (strcmp(arg, "--work") == 0) {
+            cfg.work_dir = value;
+        } else if (strcmp(arg, "--stream-above") == 0) {
+            cfg.stream_above = strtoll(value, &end, 10);
+            ok = *end == '\0' && cfg.stream_above >= 0;
+        } else if (strcmp(arg, "--repeat") == 0) {
+            ok = parse_int_list(value, &cfg.repeat, 1) == 1;
+        } else if (strcmp(arg, "--baseline") == 0) {
+            baseline_path = value;
+        } else if (strcmp(arg, "--tolerance") == 0) {
+            tolerance = strtod(value, &end);
+            ok = *end == '\0' && tolerance >= 0.0;
+        } else if (strcmp(arg, "--output") == 0) {
+            output_path = value;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid option %s %s\n", arg, value ? value : "");
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;  // Skip the option's value
+    }
+    if (min_exp > max_exp) {
+        fprintf(stderr, "--min-exp cannot be above --max-exp\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *report = fopen(output_path, "w");
+    if (report == NULL) {
+        perror("Error opening report file");
+        return EXIT_FAILURE;
+    }
+
+    int regressions = 0;
+    int faults_changed = 0;
+    int golden = check_golden(&cfg, "in.txt", "out.txt");
+    fprintf(report, "golden in.txt -> out.txt: %s\n\n", golden == 0 ? "ok" : "MISMATCH");
+    regressions += golden != 0;
+
+    static bench_result baseline[MAX_BASELINE];
+    int baseline_count = load_baseline(baseline_path, &cfg, baseline);
+    int run_count = (max_exp - min_exp + 1) * ram_count * process_count;
+    bench_result *results = calloc(run_count, sizeof(bench_result));
+    if (results == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        fclose(report);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(report, "pattern %s, policy %s, %d pages per process, baseline %s (%d entries)\n",
+            cfg.pattern, cfg.policy, cfg.pages, baseline_path, baseline_count);
+    fprintf(report, "%12s %8s %9s %14s %10s %10s %12s %10s %14s\n", "requests", "ram_size", "processes",
+            "requests_per_s", "ns_per_req", "base_ns", "peak_rss_kb", "base_rss", "faults");
+    int r = 0;
+    long long requests = 1;
+    for (int e = 0; e < min_exp; e++) {
+        requests *= 10;
+    }
+    for (int e = min_exp; e <= max_exp; e++, requests *= 10) {
+        for (int p = 0; p < process_count; p++) {
+            int stored = requests <= cfg.stream_above;
+            if (stored && ensure_trace(&cfg, requests, process_counts[p]) != 0) {
+                fprintf(stderr, "Could not generate a %lld request trace with %s\n", requests, cfg.tracegen);
+            }
+            for (int m = 0; m < ram_count; m++, r++) {
+                bench_result *res = &results[r];
+                res->requests = requests;
+                res->ram_size = ram_sizes[m];
+                res->processes = process_counts[p];
+                run_case(&cfg, res);
+
+                const bench_result *base = find_baseline(baseline, baseline_count, res);
+                const char *v = verdict(res, base, tolerance);
+                regressions += strcmp(v, "ok") != 0 && strcmp(v, "new") != 0;
+                faults_changed += strcmp(v, "FAULTS-CHANGED") == 0;
+                double ns = res->seconds * 1e9 / requests;
+                fprintf(report, "%12lld %8d %9d %14.0f %10.1f %10.1f %12ld %10ld %14ld  %s\n", requests,
+                        res->ram_size, res->processes, res->seconds > 0.0 ? requests / res->seconds : 0.0, ns,
+                        base ? base->seconds * 1e9 / requests : 0.0, res->peak_rss_kb,
+                        base ? base->peak_rss_kb : 0, res->faults, v);
+                fflush(report);
+            }
+        }
+    }
+    fclose(report);
+
+    // A new baseline must describe the same simulation; only its speed and memory may move
+    if (save_baseline && (golden != 0 || faults_changed)) {
+        fprintf(stderr, "Not saving the baseline: %s\n",
+                golden != 0 ? "the golden case does not match" : "fault counts changed");
+        save_baseline = 0;  // Both already count as regressions, so the exit status reports it
+    }
+    if (save_baseline && write_baseline(baseline_path, &cfg, results, run_count) != 0) {
+        free(results);
+        return EXIT_FAILURE;
+    }
+    free(results);
+
+    printf("%d runs, %d regressions, golden case %s; report in %s\n", run_count, regressions,
+           golden == 0 ? "ok" : "MISMATCH", output_path);
+    return regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,568 @@
+// Build: gcc -std=c11 -O2 -o bench_layout bench_layout.c
+//
+// Layout benchmark for simulation's RAM. Replays one records trace through the
+// old pointer layout (a malloc'd page struct per page, one pointer per RAM slot)
+// and through the struct-of-arrays frame table, each under the old and the new
+// bookkeeping algorithms, so the layout and the algorithms can be told apart.
+// Every cell runs the same replacement code; only the memory layout or the
+// algorithm under test differs. Reports the best of several CPU times and, when
+// the kernel exposes hardware counters, last-level cache misses.
+//
+// Both layouts and both replacement policies are re-implemented here rather than
+// linked from simulation.c, which has long since grown TLB, budget, prefetch and
+// sharing work around them. The numbers compare layouts against each other; they
+// are not measurements of simulation's own code paths.
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PAGE_FRAME_SIZE 2
+#define TIME_MAX INT_MAX
+#define NOT_RESIDENT -1
+#define REPEAT 5
+
+typedef enum { POLICY_LRU, POLICY_CLOCK, POLICY_COUNT } replacement_policy;
+typedef enum { ALLOC_LOCAL, ALLOC_GLOBAL, ALLOC_COUNT } allocation_mode;
+typedef enum { LAYOUT_POINTER, LAYOUT_SOA, LAYOUT_COUNT } ram_layout;
+typedef enum { ALGORITHMS_OLD, ALGORITHMS_NEW, ALGORITHMS_COUNT } algorithm_set;
+
+static const char *policy_names[POLICY_COUNT] = { "lru", "clock" };
+static const char *alloc_names[ALLOC_COUNT] = { "local", "global" };
+static const char *layout_names[LAYOUT_COUNT] = { "pointer", "soa" };
+static const char *algorithm_names[ALGORITHMS_COUNT] = { "scan", "indexed" };
+
+// Geometry and policy shared by every cell
+typedef struct layout_config
+{
+    int ram_size;                // RAM slots, each page occupies PAGE_FRAME_SIZE of them
+    int processes;
+    int pages_per_process;
+    replacement_policy policy;
+    allocation_mode alloc;
+    algorithm_set algorithms;    // scan: search RAM on hits and for free slots, indexed: page table and first_free
+} layout_config;
+
+// A parsed trace, one (pid, page) pair per request
+typedef struct trace
+{
+    int *pid;
+    int *page;
+    long count;
+} trace;
+
+// The page struct of the pointer layout, as simulation allocated it before the frame table
+typedef struct memory
+{
+    int process_id;
+    int page_num;
+    int last_accessed;
+    int loaded_at;
+    int referenced;
+} memory;
+
+typedef struct pointer_ram
+{
+    layout_config config;
+    memory **RAM;                // ram_size slots, NULL when free
+    memory **VirtualMemory;      // pages * PAGE_FRAME_SIZE slots, both slots of a page point to one struct
+    int *page_table;
+    int clock_hand;
+    int first_free;
+    int timeStep;
+} pointer_ram;
+
+typedef struct soa_ram
+{
+    layout_config config;
+    int frames;
+    int *process_id;             // -1 for a free frame
+    int *page_num;
+    int *last_accessed;
+    int *loaded_at;
+    unsigned char *referenced;
+    int *page_table;
+    int clock_hand;
+    int first_free;
+    int timeStep;
+} soa_ram;
+
+// Function to read a records trace ("pid page [r|w]" per line); returns 0 or -1
+static int load_trace(const char *path, const layout_config *config, trace *t) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror("Error opening trace");
+        return -1;
+    }
+    long capacity = 1 << 16;
+    t->pid = malloc(capacity * sizeof(int));
+    t->page = malloc(capacity * sizeof(int));
+    t->count = 0;
+    char line[256];
+    while (t->pid && t->page && fgets(line, sizeof(line), f)) {
+        int pid, page;
+        if (line[0] == '#' || sscanf(line, "%d %d", &pid, &page) != 2) {
+            continue;
+        }
+        if (pid < 0 || pid >= config->processes || page < 0 || page >= config->pages_per_process) {
+            fprintf(stderr, "Record %d %d is outside %d processes x %d pages\n", pid, page,
+                    config->processes, config->pages_per_process);
+            fclose(f);
+            return -1;
+        }
+        if (t->count == capacity) {
+            capacity *= 2;
+            int *pids = realloc(t->pid, capacity * sizeof(int));
+            int *pages = realloc(t->page, capacity * sizeof(int));
+            t->pid = pids ? pids : t->pid;
+            t->page = pages ? pages : t->page;
+            if (pids == NULL || pages == NULL) {
+                break;
+            }
+        }
+        t->pid[t->count] = pid;
+        t->page[t->count] = page;
+        t->count++;
+    }
+    fclose(f);
+    if (t->pid == NULL || t->page == NULL || t->count < 1) {
+        fprintf(stderr, "No records read from %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to free the pointer layout, page structs included
+static void destroy_pointer(pointer_ram *ram) {
+    if (ram->VirtualMemory) {
+        int slots = ram->config.processes * ram->config.pages_per_process * PAGE_FRAME_SIZE;
+        for (int x = 0; x < slots; x += PAGE_FRAME_SIZE) {
+            free(ram->VirtualMemory[x]);
+        }
+    }
+    free(ram->VirtualMemory);
+    free(ram->RAM);
+    free(ram->page_table);
+}
+
+// Function to build the pointer layout the way initialize_VM did: one calloc per page
+static int init_pointer(pointer_ram *ram, const layout_config *config) {
+    memset(ram, 0, sizeof(*ram));
+    ram->config = *config;
+    int pages = config->processes * config->pages_per_process;
+    ram->RAM = calloc(config->ram_size, sizeof(memory *));
+    ram->VirtualMemory = calloc((size_t)pages * PAGE_FRAME_SIZE, sizeof(memory *));
+    ram->page_table = malloc(pages * sizeof(int));
+    if (ram->RAM == NULL || ram->VirtualMemory == NULL || ram->page_table == NULL) {
+        destroy_pointer(ram);
+        return -1;
+    }
+    for (int x = 0; x < pages * PAGE_FRAME_SIZE; x += PAGE_FRAME_SIZE) {
+        memory *page = calloc(1, sizeof(memory));
+        if (page == NULL) {
+            destroy_pointer(ram);
+            return -1;
+        }
+        page->process_id = x / (config->pages_per_process * PAGE_FRAME_SIZE);
+        page->page_num = (x / PAGE_FRAME_SIZE) % config->pages_per_process;
+        ram->VirtualMemory[x] = ram->VirtualMemory[x + 1] = page;
+    }
+    for (int i = 0; i < pages; i++) {
+        ram->page_table[i] = NOT_RESIDENT;
+    }
+    return 0;
+}
+
+// Least recently used slot of a process, or of any process when processID is -1
+static int pointer_lru(pointer_ram *ram, int processID) {
+    int min_time = TIME_MAX;
+    int lru_index = -1;
+    for (int i = 0; i < ram->config.ram_size; i += PAGE_FRAME_SIZE) {
+        memory *page = ram->RAM[i];
+        if (page && (processID < 0 || page->process_id == processID) && page->last_accessed < min_time) {
+            min_time = page->last_accessed;
+            lru_index = i;
+        }
+    }
+    return lru_index;
+}
+
+// Second-chance slot of a process, or of any process when processID is -1
+static int pointer_clock(pointer_ram *ram, int processID) {
+    int ram_size = ram->config.ram_size;
+    for (int step = 0; step < 2 * ram_size; step += PAGE_FRAME_SIZE) {
+        int i = ram->clock_hand;
+        ram->clock_hand = (ram->clock_hand + PAGE_FRAME_SIZE) % ram_size;
+        memory *page = ram->RAM[i];
+        if (page == NULL || (processID >= 0 && page->process_id != processID)) {
+            continue;
+        }
+        if (!page->referenced) {
+            return i;
+        }
+        page->referenced = 0;
+    }
+    return -1;
+}
+
+// Function to serve one request on the pointer layout; returns 1 on a fault
+static int pointer_request(pointer_ram *ram, int processID, int page_num) {
+    const layout_config *c = &ram->config;
+    int *entry = &ram->page_table[processID * c->pages_per_process + page_num];
+    ram->timeStep++;
+    if (*entry != NOT_RESIDENT) {
+        memory *page = NULL;
+        if (c->algorithms == ALGORITHMS_NEW) {
+            page = ram->RAM[*entry * PAGE_FRAME_SIZE];
+        } else {
+            for (int i = 0; i < c->ram_size && page == NULL; i += PAGE_FRAME_SIZE) {
+                if (ram->RAM[i] && ram->RAM[i]->process_id == processID && ram->RAM[i]->page_num == page_num) {
+                    page = ram->RAM[i];
+                }
+            }
+        }
+        page->last_accessed = ram->timeStep;
+        page->referenced = 1;
+        return 0;
+    }
+
+    int slot = -1;
+    if (c->algorithms == ALGORITHMS_NEW) {
+        while (ram->first_free < c->ram_size && ram->RAM[ram->first_free] != NULL) {
+            ram->first_free += PAGE_FRAME_SIZE;
+        }
+        slot = ram->first_free < c->ram_size ? ram->first_free : -1;
+    } else {
+        for (int i = 0; i < c->ram_size && slot == -1; i += PAGE_FRAME_SIZE) {
+            slot = ram->RAM[i] == NULL ? i : -1;
+        }
+    }
+    if (slot == -1) {
+        int local = c->alloc == ALLOC_LOCAL ? processID : -1;
+        slot = c->policy == POLICY_CLOCK ? pointer_clock(ram, local) : pointer_lru(ram, local);
+        if (slot == -1) {
+            slot = c->policy == POLICY_CLOCK ? pointer_clock(ram, -1) : pointer_lru(ram, -1);
+        }
+        memory *victim = ram->RAM[slot];
+        ram->page_table[victim->process_id * c->pages_per_process + victim->page_num] = NOT_RESIDENT;
+    }
+    memory *page = ram->VirtualMemory[(processID * c->pages_per_process + page_num) * PAGE_FRAME_SIZE];
+    for (int i = 0; i < PAGE_FRAME_SIZE; i++) {
+        ram->RAM[slot + i] = page;
+        ram->RAM[slot + i]->last_accessed = ram->timeStep;
+    }
+    page->loaded_at = ram->timeStep;
+    page->referenced = 0;
+    *entry = slot / PAGE_FRAME_SIZE;
+    return 1;
+}
+
+// Function to free the frame table
+static void destroy_soa(soa_ram *ram) {
+    free(ram->process_id);
+    free(ram->page_num);
+    free(ram->last_accessed);
+    free(ram->loaded_at);
+    free(ram->referenced);
+    free(ram->page_table);
+}
+
+// Function to build the struct-of-arrays frame table
+static int init_soa(soa_ram *ram, const layout_config *config) {
+    memset(ram, 0, sizeof(*ram));
+    ram->config = *config;
+    ram->frames = config->ram_size / PAGE_FRAME_SIZE;
+    int pages = config->processes * config->pages_per_process;
+    ram->process_id = malloc(ram->frames * sizeof(int));
+    ram->page_num = malloc(ram->frames * sizeof(int));
+    ram->last_accessed = calloc(ram->frames, sizeof(int));
+    ram->loaded_at = calloc(ram->frames, sizeof(int));
+    ram->referenced = calloc(ram->frames, 1);
+    ram->page_table = malloc(pages * sizeof(int));
+    if (ram->process_id == NULL || ram->page_num == NULL || ram->last_accessed == NULL || ram->loaded_at == NULL ||
+        ram->referenced == NULL || ram->page_table == NULL) {
+        destroy_soa(ram);
+        return -1;
+    }
+    for (int f = 0; f < ram->frames; f++) {
+        ram->process_id[f] = -1;
+    }
+    for (int i = 0; i < pages; i++) {
+        ram->page_table[i] = NOT_RESIDENT;
+    }
+    return 0;
+}
+
+// Least recently used frame of a process, or of any process when processID is -1
+static int soa_lru(soa_ram *ram, int processID) {
+    int min_time = TIME_MAX;
+    int lru_index = -1;
+    for (int f = 0; f < ram->frames; f++) {
+        int owner = ram->process_id[f];
+        if (owner != -1 && (processID < 0 || owner == processID) && ram->last_accessed[f] < min_time) {
+            min_time = ram->last_accessed[f];
+            lru_index = f;
+        }
+    }
+    return lru_index;
+}
+
+// Second-chance frame of a process, or of any process when processID is -1
+static int soa_clock(soa_ram *ram, int processID) {
+    for (int step = 0; step < 2 * ram->frames; step++) {
+        int f = ram->clock_hand;
+        ram->clock_hand = (ram->clock_hand + 1) % ram->frames;
+        int owner = ram->process_id[f];
+        if (owner == -1 || (processID >= 0 && owner != processID)) {
+            continue;
+        }
+        if (!ram->referenced[f]) {
+            return f;
+        }
+        ram->referenced[f] = 0;
+    }
+    return -1;
+}
+
+// Function to serve one request on the frame table; returns 1 on a fault
+static int soa_request(soa_ram *ram, int processID, int page_num) {
+    const layout_config *c = &ram->config;
+    int *entry = &ram->page_table[processID * c->pages_per_process + page_num];
+    ram->timeStep++;
+    if (*entry != NOT_RESIDENT) {
+        int frame = -1;
+        if (c->algorithms == ALGORITHMS_NEW) {
+            frame = *entry;
+        } else {
+            for (int f = 0; f < ram->frames && frame == -1; f++) {
+                if (ram->process_id[f] == processID && ram->page_num[f] == page_num) {
+                    frame = f;
+                }
+            }
+        }
+        ram->last_accessed[frame] = ram->timeStep;
+        ram->referenced[frame] = 1;
+        return 0;
+    }
+
+    int frame = -1;
+    if (c->algorithms == ALGORITHMS_NEW) {
+        while (ram->first_free < ram->frames && ram->process_id[ram->first_free] != -1) {
+            ram->first_free++;
+        }
+        frame = ram->first_free < ram->frames ? ram->first_free : -1;
+    } else {
+        for (int f = 0; f < ram->frames && frame == -1; f++) {
+            frame = ram->process_id[f] == -1 ? f : -1;
+        }
+    }
+    if (frame == -1) {
+        int local = c->alloc == ALLOC_LOCAL ? processID : -1;
+        frame = c->policy == POLICY_CLOCK ? soa_clock(ram, local) : soa_lru(ram, local);
+        if (frame == -1) {
+            frame = c->policy == POLICY_CLOCK ? soa_clock(ram, -1) : soa_lru(ram, -1);
+        }
+        ram->page_table[ram->process_id[frame] * c->pages_per_process + ram->page_num[frame]] = NOT_RESIDENT;
+    }
+    ram->process_id[frame] = processID;
+    ram->page_num[frame] = page_num;
+    ram->last_accessed[frame] = ram->timeStep;
+    ram->loaded_at[frame] = ram->timeStep;
+    ram->referenced[frame] = 0;
+    *entry = frame;
+    return 1;
+}
+
+// Function to open a last-level cache miss counter for this process; -1 when the kernel has none
+static int open_miss_counter(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static double cpu_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Function to replay the trace once on a fresh layout; returns the fault count, -1 if out of memory
+static long replay(ram_layout layout, const layout_config *config, const trace *t, int counter,
+                   double *seconds, long long *misses) {
+    pointer_ram pointer;
+    soa_ram soa;
+    if (layout == LAYOUT_POINTER ? init_pointer(&pointer, config) : init_soa(&soa, config)) {
+        return -1;
+    }
+    long faults = 0;
+    long long count = 0;
+    if (counter != -1) {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    double start = cpu_seconds();
+    if (layout == LAYOUT_POINTER) {
+        for (long i = 0; i < t->count; i++) {
+            faults += pointer_request(&pointer, t->pid[i], t->page[i]);
+        }
+    } else {
+        for (long i = 0; i < t->count; i++) {
+            faults += soa_request(&soa, t->pid[i], t->page[i]);
+        }
+    }
+    *seconds = cpu_seconds() - start;
+    if (counter != -1) {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counter, &count, sizeof(count)) != sizeof(count)) {
+            count = -1;
+        }
+    }
+    *misses = counter != -1 ? count : -1;
+    if (layout == LAYOUT_POINTER) {
+        destroy_pointer(&pointer);
+    } else {
+        destroy_soa(&soa);
+    }
+    return faults;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s TRACE [options]\n", program);
+    fprintf(stderr, "  TRACE                  records trace, e.g. from tracegen\n");
+    fprintf(stderr, "  --processes N          processes in the trace (default 4)\n");
+    fprintf(stderr, "  --pages N              pages per process (default 4)\n");
+    fprintf(stderr, "  --ram N                RAM slots, %d per page (default 16)\n", PAGE_FRAME_SIZE);
+    fprintf(stderr, "  --policy lru|clock     replacement policy (default lru)\n");
+    fprintf(stderr, "  --alloc local|global   victim scope (default local)\n");
+    fprintf(stderr, "  --repeat N             runs per cell, the fastest is reported (default %d)\n", REPEAT);
+}
+
+// Function to look up a name in a names array; returns its index or -1
+static int parse_name(const char *value, const char **names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(value, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    layout_config config = { 16, 4, 4, POLICY_LRU, ALLOC_LOCAL, ALGORITHMS_NEW };
+    const char *trace_path = NULL;
+    int repeat = REPEAT;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = 1;
+        if (arg[0] != '-' && trace_path == NULL) {
+            trace_path = arg;
+            continue;
+        }
+        if (value == NULL) {
+            ok = 0;
+        } else if (strcmp(arg, "--processes") == 0) {
+            config.processes = atoi(value);
+            ok = config.processes > 0;
+        } else if (strcmp(arg, "--pages") == 0) {
+            config.pages_per_process = atoi(value);
+            ok = config.pages_per_process > 0;
+        } else if (strcmp(arg, "--ram") == 0) {
+            config.ram_size = atoi(value);
+            ok = config.ram_size >= PAGE_FRAME_SIZE && config.ram_size % PAGE_FRAME_SIZE == 0;
+        } else if (strcmp(arg, "--policy") == 0) {
+            int policy = parse_name(value, policy_names, POLICY_COUNT);
+            config.policy = (replacement_policy)policy;
+            ok = policy >= 0;
+        } else if (strcmp(arg, "--alloc") == 0) {
+            int alloc = parse_name(value, alloc_names, ALLOC_COUNT);
+            config.alloc = (allocation_mode)alloc;
+            ok = alloc >= 0;
+        } else if (strcmp(arg, "--repeat") == 0) {
+            repeat = atoi(value);
+            ok = repeat > 0;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid option %s %s\n", arg, value ? value : "");
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;  // Skip the option's value
+    }
+    if (trace_path == NULL) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    trace t;
+    if (load_trace(trace_path, &config, &t) != 0) {
+        return EXIT_FAILURE;
+    }
+    int counter = open_miss_counter();
+
+    printf("%ld requests, %d processes x %d pages, ram %d, %s %s, best of %d\n", t.count, config.processes,
+           config.pages_per_process, config.ram_size, alloc_names[config.alloc], policy_names[config.policy],
+           repeat);
+    printf("%-8s %-9s %10s %10s %10s %14s\n", "layout", "algorithm", "seconds", "ns_per_req", "faults", "llc_misses");
+    long expected = -1;
+    int mismatch = 0;
+    for (int a = 0; a < ALGORITHMS_COUNT; a++) {
+        config.algorithms = (algorithm_set)a;
+        for (int l = 0; l < LAYOUT_COUNT; l++) {
+            double best = 0.0;
+            long long best_misses = -1;
+            long faults = -1;
+            for (int r = 0; r < repeat; r++) {
+                double seconds;
+                long long misses;
+                faults = replay((ram_layout)l, &config, &t, counter, &seconds, &misses);
+                if (faults < 0) {
+                    fprintf(stderr, "Out of memory\n");
+                    return EXIT_FAILURE;
+                }
+                if (r == 0 || seconds < best) {
+                    best = seconds;
+                    best_misses = misses;
+                }
+            }
+            // Every cell models the same policy, so any difference in faults is a bug in this file
+            mismatch |= expected != -1 && faults != expected;
+            expected = faults;
+            char misses[32];
+            if (best_misses < 0) {
+                snprintf(misses, sizeof(misses), "n/a");
+            } else {
+                snprintf(misses, sizeof(misses), "%lld", best_misses);
+            }
+            printf("%-8s %-9s %10.3f %10.1f %10ld %14s\n", layout_names[l], algorithm_names[a], best,
+                   best * 1e9 / t.count, faults, misses);
+        }
+    }
+    if (counter != -1) {
+        close(counter);
+    }
+    free(t.pid);
+    free(t.page);
+    if (mismatch) {
+        fprintf(stderr, "Fault counts differ between cells\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,198 +1,3634 @@
+// Build: gcc -std=c11 -O2 -pthread -o simulation simulation.c
+#define _DEFAULT_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
 
 #define RAM_SIZE 16
-#define VM_SIZE 32
 #define PAGE_FRAME_SIZE 2
 #define PROCESSES 4
 #define PAGES_PER_PROCESS 4
-#define TIME_MAX 10000
+#define TIME_MAX LLONG_MAX
+#define NOT_RESIDENT -1          // page_table value for a page that lives in virtual memory
+#define IN_VIRTUAL_MEMORY 99     // how a non-resident page is printed in the output file
+#define MAX_SWEEP_VALUES 32      // most values a single sweep option can list
+#define READ_BUFFER_SIZE 65536   // bytes the trace reader pulls from the input at a time
+#define WSET_WINDOW 100          // default working-set window tau, in time steps
+#define PFF_WINDOW 50            // default references per page-fault-frequency measurement
+#define PFF_LOW 0.05             // default fault rate below which a process gives up a frame
+#define PFF_HIGH 0.25            // default fault rate above which a process is granted a frame
+#define FRAME_BUSY -2            // owner of a shared frame while one CPU evicts or fills it
+#define SHARED_MAPPING -3        // page_table value of a shared page; shared_frame has its frame
+#define LRU_SAMPLES 8            // frames the shared approximate LRU compares per eviction
+#define LRU_STAMP_BATCH 64       // requests a CPU serves before it advances the shared LRU clock
+#define SNAPSHOT_MAGIC "VMSNAP07"      // first bytes of a checkpoint file, with its format version
+#define CHECKPOINT_INTERVAL 1000000    // default requests between checkpoints
+#define WRITE_BUFFER_SIZE (1 << 20)    // bytes collected before the stream and the final dump hit the file
+#define STREAM_MAGIC "VMSTRM02"        // first bytes of a binary stream, with its format version
+#define STREAM_INTERVAL 100000         // default requests between streamed snapshots
+#define PREFETCH_DEPTH 8               // default pages read ahead, and the largest adaptive window
+#define PREFETCH_UNUSED 1              // prefetch_state bit: prefetched and not referenced yet
+#define PREFETCH_DISPLACED 2           // prefetch_state bit: evicted to make room for a prefetch
+#define VPN_BITS 36                    // virtual page number bits of a 48-bit address with 4 KiB pages
+#define RADIX_MAX_LEVELS 4
+#define PTE_BYTES 8                    // one entry of a flat table or a radix node
+#define HASHED_PTE_BYTES 16            // one hashed or inverted entry: tag, frame and chain link
+#define HASH_ANCHOR_BYTES 4            // head of one hash chain
+#define HUGE_PAGE_SIZE 512             // default base pages per huge page (2 MiB of 4 KiB pages)
+
+typedef enum { POLICY_LRU, POLICY_FIFO, POLICY_CLOCK, POLICY_COUNT } replacement_policy;
+typedef enum { ALLOC_LOCAL, ALLOC_GLOBAL, ALLOC_EQUAL, ALLOC_PROPORTIONAL, ALLOC_WSET, ALLOC_PFF, ALLOC_COUNT } allocation_mode;
+typedef enum { STATS_CSV, STATS_JSON, STATS_FORMAT_COUNT } stats_format;
+typedef enum { TRACE_PIDS, TRACE_RECORDS, TRACE_FORMAT_COUNT } trace_format;
+typedef enum { TLB_LRU, TLB_FIFO, TLB_RANDOM, TLB_POLICY_COUNT } tlb_policy;
+typedef enum { TLB_FLUSH, TLB_ASID, TLB_SWITCH_COUNT } tlb_switch;
+typedef enum { STREAM_DELTAS, STREAM_SNAPSHOTS, STREAM_KIND_COUNT } stream_kind;
+typedef enum { STREAM_TEXT, STREAM_BINARY, STREAM_FORMAT_COUNT } stream_format;
+typedef enum { PREFETCH_NONE, PREFETCH_NEXT, PREFETCH_STRIDE, PREFETCH_ADAPTIVE, PREFETCH_COUNT } prefetch_mode;
+typedef enum { PT_FLAT, PT_RADIX2, PT_RADIX3, PT_RADIX4, PT_HASHED, PT_INVERTED, PT_KIND_COUNT } page_table_kind;
+
+static const char *policy_names[POLICY_COUNT] = { "lru", "fifo", "clock" };
+static const char *alloc_names[ALLOC_COUNT] = { "local", "global", "equal", "proportional", "wset", "pff" };
+static const char *stats_format_names[STATS_FORMAT_COUNT] = { "csv", "json" };
+static const char *trace_format_names[TRACE_FORMAT_COUNT] = { "pids", "records" };
+static const char *tlb_policy_names[TLB_POLICY_COUNT] = { "lru", "fifo", "random" };
+static const char *tlb_switch_names[TLB_SWITCH_COUNT] = { "flush", "asid" };
+static const char *stream_kind_names[STREAM_KIND_COUNT] = { "deltas", "snapshots" };
+static const char *stream_format_names[STREAM_FORMAT_COUNT] = { "text", "binary" };
+static const char *prefetch_names[PREFETCH_COUNT] = { "none", "next", "stride", "adaptive" };
+static const char *page_table_names[PT_KIND_COUNT] = { "flat", "radix2", "radix3", "radix4", "hashed", "inverted" };
+
+// Counters kept for every process and for the whole simulation
+typedef struct process_stats
+{
+    long hits;
+    long compulsory_faults;   // first reference to the page
+    long capacity_faults;     // would also miss in a fully associative LRU RAM of the same size
+    long conflict_faults;     // would have hit in that LRU RAM, lost to the replacement rule
+    long local_evictions;     // victims taken from the faulting process itself
+    long global_evictions;    // victims taken from any process
+    long frames_held;
+    long tlb_hits;
+    long tlb_misses;          // each one costs a page-table walk
+    long tlb_flushes;         // whole-TLB flushes on switching to this process
+    long tlb_shootdowns;      // this process's entries invalidated by an eviction
+    long suspensions;         // times load control swapped the process out
+    long deferred_requests;   // requests held back while the process was suspended
+    long prefetches;          // pages brought in ahead of a request
+    long prefetch_hits;       // prefetched pages referenced before they were evicted
+    long prefetch_unused;     // prefetched pages evicted without a reference
+    long prefetch_pollution;  // faults on pages a prefetch pushed out that demand LRU would have kept
+    long cow_faults;          // writes that gave the process its own copy of a shared page
+    long frames_saved;        // shared pages mapped in another process's frame, less shared frames held
+                              // but no longer mapped; set when the counters are summed
+    long walk_references;     // page-table entries read by the walks of the modelled organization
+    long page_table_bytes;    // size of the process's page table; the total adds the parts no process
+                              // owns (hash anchors, free inverted entries); set when the counters are summed
+    long huge_mappings;       // faults that mapped a whole huge page
+    long huge_splits;         // huge pages broken into base pages because one of their pages was evicted
+} process_stats;
+
+// Columns of a statistics record after "hits" and "faults", in output order
+static const struct { const char *name; size_t offset; } stats_columns[] = {
+    { "compulsory", offsetof(process_stats, compulsory_faults) },
+    { "capacity", offsetof(process_stats, capacity_faults) },
+    { "conflict", offsetof(process_stats, conflict_faults) },
+    { "local_evictions", offsetof(process_stats, local_evictions) },
+    { "global_evictions", offsetof(process_stats, global_evictions) },
+    { "frames_held", offsetof(process_stats, frames_held) },
+    { "tlb_hits", offsetof(process_stats, tlb_hits) },
+    { "tlb_misses", offsetof(process_stats, tlb_misses) },
+    { "tlb_flushes", offsetof(process_stats, tlb_flushes) },
+    { "tlb_shootdowns", offsetof(process_stats, tlb_shootdowns) },
+    { "suspensions", offsetof(process_stats, suspensions) },
+    { "deferred_requests", offsetof(process_stats, deferred_requests) },
+    { "prefetches", offsetof(process_stats, prefetches) },
+    { "prefetch_hits", offsetof(process_stats, prefetch_hits) },
+    { "prefetch_unused", offsetof(process_stats, prefetch_unused) },
+    { "prefetch_pollution", offsetof(process_stats, prefetch_pollution) },
+    { "cow_faults", offsetof(process_stats, cow_faults) },
+    { "frames_saved", offsetof(process_stats, frames_saved) },
+    { "walk_references", offsetof(process_stats, walk_references) },
+    { "page_table_bytes", offsetof(process_stats, page_table_bytes) },
+    { "huge_mappings", offsetof(process_stats, huge_mappings) },
+    { "huge_splits", offsetof(process_stats, huge_splits) },
+};
+#define STATS_COLUMNS (int)(sizeof(stats_columns) / sizeof(stats_columns[0]))
+#define STATS_COLUMN(p, c) (*(const long *)((const char *)(p) + stats_columns[c].offset))
+
+// Geometry and policy of one simulator instance
+typedef struct sim_config
+{
+    int ram_size;                // RAM slots, each page occupies PAGE_FRAME_SIZE of them
+    int processes;
+    int pages_per_process;
+    replacement_policy policy;
+    allocation_mode alloc;       // local: evict the requester's own page first, global: any page,
+                                 // equal, proportional, wset, pff: replace locally once the process
+                                 // holds its frame budget
+    int tlb_entries;             // 0 disables the TLB
+    int tlb_ways;                // entries per set, tlb_entries for a fully associative TLB
+    tlb_policy tlb_policy;
+    tlb_switch tlb_switch;       // flush on every process switch, or tag entries with an ASID
+    int wset_window;             // working-set window tau in time steps (wset)
+    int pff_window;              // references per fault-rate measurement (pff)
+    double pff_low;              // fault rate that shrinks the budget by a frame (pff)
+    double pff_high;             // fault rate that grows the budget by a frame (pff)
+    int load_control;            // suspend processes while the budgets exceed RAM (wset, pff)
+    prefetch_mode prefetch;      // read ahead after a fault or the first use of a prefetched page
+    int prefetch_depth;          // pages read ahead (next, stride), the largest window (adaptive)
+    int shared_pages;            // pages 0..shared_pages-1 of every process map one shared segment
+    int cow;                     // the segment is copy-on-write: a write gives the writer its own copy
+    page_table_kind page_table_kind;  // organization whose walks and size are counted
+    int huge_pages;              // pages 0..huge_pages-1 of every process are backed by huge pages
+    int huge_page_size;          // base pages per huge page, a power of two
+} sim_config;
 
-typedef struct memory
+// Frame table: one entry per page frame, kept as parallel arrays so the
+// replacement scans walk contiguous memory. A page still occupies
+// PAGE_FRAME_SIZE RAM slots; slot i belongs to frame i / PAGE_FRAME_SIZE.
+typedef struct frame_table
 {
-    int process_id;
+    int *process_id;             // owning process, -1 for a free frame
+    int *page_num;
+    long long *last_accessed;
+    long long *loaded_at;        // time step the page was brought into RAM (FIFO)
+    unsigned char *referenced;   // reference bit (CLOCK)
+    unsigned char *shared;       // holds a page of the shared segment; NULL without one
+} frame_table;
+
+// Set-associative translation cache in front of the page table; entry e of set s is s * ways + e
+typedef struct tlb
+{
+    int sets;
+    int ways;
+    int *pid;                    // address space of the entry, -1 when invalid
+    int *page_num;
+    int *frame;
+    long long *stamp;            // last use (LRU) or fill time (FIFO)
+    unsigned int random_state;   // xorshift32 state for the random policy
+    int current_pid;             // process the TLB was last used by, -1 before the first request
+} tlb;
+
+// Large write buffer in front of a FILE; numbers are formatted by hand instead of fprintf
+typedef struct output_buffer
+{
+    FILE *file;
+    char *data;
+    size_t length;
+    size_t capacity;
+    int failed;              // a write to the file failed
+} output_buffer;
+
+// One page request: a process touching one of its pages
+typedef struct request
+{
+    int pid;
     int page_num;
-    int last_accessed;
-} memory;
+    int write;        // 1 for a write record, 0 for a read
+} request;
+
+// Requests of a suspended process, replayed in order when it resumes
+typedef struct request_queue
+{
+    request *requests;
+    int head;
+    int length;
+    int capacity;
+} request_queue;
+
+typedef struct simulator
+{
+    sim_config config;
+    int frames;                  // ram_size / PAGE_FRAME_SIZE
+    frame_table RAM;
+    int first_free;              // no frame below this one is free
+    int *page_table;             // processes x pages_per_process frame numbers
+    long long timeStep;          // Tracks the simulation time step
+    int clock_hand;              // next frame the CLOCK policy inspects
+    tlb tlb;                     // entries are NULL when the TLB is disabled
+
+    process_stats *stats;        // one entry per process
+    process_stats total;
+    char *touched;               // pages referenced at least once (compulsory faults)
+
+    // Fully associative LRU shadow of the same number of frames (capacity vs conflict faults).
+    // Entries 0..pages-1 are private pages, then one entry per page of the shared segment
+    int *shadow_prev;
+    int *shadow_next;
+    char *in_shadow;
+    int shadow_head;
+    int shadow_tail;
+    int shadow_count;
+
+    FILE *stats_file;            // optional time series and summary output
+    stats_format stats_format;
+    int sample_interval;         // emit a sample every N steps, 0 for the summary only
+    int samples_written;
+
+    output_buffer *stream;       // optional record of how the run evolves, NULL when off
+    stream_kind stream_kind;
+    stream_format stream_format;
+    int stream_interval;         // requests between snapshots (snapshots)
+
+    // Frame budgets (equal, proportional, wset, pff); NULL under local and global
+    int *budget;                 // frames a process may hold before it has to replace its own pages
+    long demand;                 // budgets of the processes that are not suspended
+    int *footprint;              // distinct pages each process has touched (proportional)
+    int footprint_total;
+    long long *last_reference;   // latest time step each page was referenced, -1 if never (wset)
+    int *window;                 // page referenced at each of the last tau time steps, a ring (wset)
+    int *working_set;            // pages of each process referenced in the last tau steps (wset)
+    int *pff_references;         // references and faults of each process in its current window (pff)
+    int *pff_faults;
+
+    // Load control; suspended is NULL when it is off
+    char *suspended;
+    int *suspend_order;          // suspended processes, oldest first, a ring
+    int *aged_out;               // pages that left a suspended process's window, still in its working set (wset)
+    int suspend_head;
+    int suspended_count;
+    request_queue *deferred;     // one queue per process
+
+    // Prefetching; prefetch_state is NULL when it is off
+    unsigned char *prefetch_state;  // PREFETCH_UNUSED and PREFETCH_DISPLACED bits of every page
+    int *prefetch_last;          // page of each process's latest fault or prefetch hit, -1 before the first
+    int *prefetch_stride;        // distance from the page before it
+    int *prefetch_window;        // pages each process reads ahead (adaptive)
+
+    // Shared segment; shared_frame is NULL without one. A shared page is loaded and evicted
+    // through its single shared_frame entry, however many processes map it.
+    int *shared_frame;           // frame of each shared page, NOT_RESIDENT when it is out
+    int *sharers;                // processes still mapping each shared page (reference count)
+    char *private_copy;          // processes x shared_pages: the process has its own copy (cow)
+
+    // Page-table organization. page_table above still does the translating; these track what a
+    // radix, hashed or inverted table would hold, to count its walks and its size. Entries and
+    // nodes are made by the first walk that needs them and, as in most kernels, never freed.
+    unsigned char *radix_nodes[RADIX_MAX_LEVELS];  // allocated nodes of each level below the root,
+                                                   // processes x nodes of the level (radix)
+    char *pt_mapped;             // pages with an entry in the hashed table
+    int *pt_head;                // first entry of each hash chain: a page (hashed) or a frame (inverted)
+    int *pt_next;                // next entry of the chain, -1 at its end
+    int pt_hash_bits;            // there are 1 << pt_hash_bits chains
+    char *huge_mapped;           // processes x huge pages: mapped as one page; NULL without huge pages
+} simulator;
+
+// A trace loaded once and shared read-only between simulator instances
+typedef struct trace
+{
+    request *requests;
+    long length;
+} trace;
+
+// Buffered parser for both input formats:
+//   pids     the original format, process ids separated by blanks; the page is
+//            derived from the time step
+//   records  one "pid page [r|w]" record per line, '#' starts a comment line
+typedef struct trace_reader
+{
+    FILE *file;
+    const char *filename;
+    sim_config config;
+    trace_format format;
+    char buffer[READ_BUFFER_SIZE];
+    size_t length;           // bytes held in buffer
+    size_t pos;              // next byte of buffer to parse
+    long long offset;        // file offset of buffer[0]
+    long count;              // requests returned so far
+    long line;               // current line, for error messages
+} trace_reader;
+
+#define PAGE_TABLE(sim, pid, page) ((sim)->page_table[(pid) * (sim)->config.pages_per_process + (page)])
+
+// Whether the huge page holding a page is mapped as one, and the TLB tag of that huge page, which
+// lies past every base page of the process
+#define HUGE_MAPPED(sim, pid, page) \
+    ((sim)->huge_mapped[(pid) * ((sim)->config.huge_pages / (sim)->config.huge_page_size) + \
+                        (page) / (sim)->config.huge_page_size])
+#define HUGE_TLB_TAG(sim, page) ((sim)->config.pages_per_process + (page) / (sim)->config.huge_page_size)
+
+// Frame holding a page of the process, following a shared mapping; NOT_RESIDENT when it is out
+static inline int page_frame(const simulator *sim, int processID, int page_num) {
+    int frame = PAGE_TABLE(sim, processID, page_num);
+    return frame == SHARED_MAPPING ? sim->shared_frame[page_num] : frame;
+}
+
+static inline int huge_mapped(const simulator *sim, int processID, int page_num) {
+    return page_num < sim->config.huge_pages && HUGE_MAPPED(sim, processID, page_num);
+}
+
+static inline int radix_levels(const sim_config *config) {
+    return config->page_table_kind - PT_RADIX2 + 2;
+}
+
+// Virtual page number bits below the nodes of a radix level; the root is level 0
+static inline int radix_shift(int levels, int level) {
+    return VPN_BITS / levels * (levels - level);
+}
+
+// Levels above the leaves at which a radix table translates a huge page: the level whose entries
+// each cover huge_page_size base pages. 0 when no level's entries cover exactly that many.
+static inline int huge_page_levels(const sim_config *config) {
+    int levels = radix_levels(config);
+    for (int l = 1; l < levels; l++) {
+        if (config->huge_page_size == 1 << (VPN_BITS / levels * l)) {
+            return l;
+        }
+    }
+    return 0;
+}
+
+// Nodes of a radix level needed to cover every page of a process
+static inline int radix_level_nodes(const sim_config *config, int level) {
+    return ((config->pages_per_process - 1) >> radix_shift(radix_levels(config), level)) + 1;
+}
+
+// Chain of a page, given as its index over all processes, in a hashed or inverted table
+static inline int pt_hash(const simulator *sim, int page) {
+    return (int)((unsigned int)page * 2654435761u >> (32 - sim->pt_hash_bits));
+}
+
+// Function to hand the buffered bytes to the file
+static void out_flush(output_buffer *out) {
+    if (out->length > 0 && fwrite(out->data, 1, out->length, out->file) != out->length) {
+        out->failed = 1;
+    }
+    out->length = 0;
+}
+
+static inline void out_bytes(output_buffer *out, const void *bytes, size_t size) {
+    if (out->length + size > out->capacity) {
+        out_flush(out);
+        if (size > out->capacity) {
+            out->failed |= fwrite(bytes, 1, size, out->file) != size;
+            return;
+        }
+    }
+    memcpy(out->data + out->length, bytes, size);
+    out->length += size;
+}
+
+static inline void out_text(output_buffer *out, const char *text) {
+    out_bytes(out, text, strlen(text));
+}
+
+// Function to append a number in decimal
+static inline void out_int(output_buffer *out, long long value) {
+    char digits[21];
+    int n = sizeof(digits);
+    unsigned long long v = value < 0 ? 0ull - (unsigned long long)value : (unsigned long long)value;
+    do {
+        digits[--n] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    if (value < 0) {
+        digits[--n] = '-';
+    }
+    out_bytes(out, digits + n, sizeof(digits) - n);
+}
+
+// Function to append a record of one page event to the stream: 'L' load, 'E' evict, 'H' hit
+static void record_event(simulator *sim, char type, int processID, int page_num, int frame) {
+    output_buffer *out = sim->stream;
+    if (sim->stream_format == STREAM_BINARY) {
+        int fields[3] = { processID, page_num, frame };
+        out_bytes(out, &type, 1);
+        out_bytes(out, &sim->timeStep, sizeof(long long));
+        out_bytes(out, fields, sizeof(fields));
+        return;
+    }
+    char prefix[2] = { type, ' ' };
+    out_bytes(out, prefix, 2);
+    out_int(out, sim->timeStep);
+    out_bytes(out, " ", 1);
+    out_int(out, processID);
+    out_bytes(out, " ", 1);
+    out_int(out, page_num);
+    out_bytes(out, " ", 1);
+    out_int(out, frame);
+    out_bytes(out, "\n", 1);
+}
+
+// Function to release a simulator
+void destroy_VM(simulator *sim)
+{
+    if (sim == NULL) {
+        return;
+    }
+    free(sim->RAM.process_id);
+    free(sim->RAM.page_num);
+    free(sim->RAM.last_accessed);
+    free(sim->RAM.loaded_at);
+    free(sim->RAM.referenced);
+    free(sim->RAM.shared);
+    free(sim->tlb.pid);
+    free(sim->tlb.page_num);
+    free(sim->tlb.frame);
+    free(sim->tlb.stamp);
+    free(sim->page_table);
+    free(sim->stats);
+    free(sim->touched);
+    free(sim->shadow_prev);
+    free(sim->shadow_next);
+    free(sim->in_shadow);
+    free(sim->budget);
+    free(sim->footprint);
+    free(sim->last_reference);
+    free(sim->window);
+    free(sim->working_set);
+    free(sim->pff_references);
+    free(sim->pff_faults);
+    free(sim->suspended);
+    free(sim->suspend_order);
+    free(sim->aged_out);
+    if (sim->deferred) {
+        for (int i = 0; i < sim->config.processes; i++) {
+            free(sim->deferred[i].requests);
+        }
+        free(sim->deferred);
+    }
+    free(sim->prefetch_state);
+    free(sim->prefetch_last);
+    free(sim->prefetch_stride);
+    free(sim->prefetch_window);
+    free(sim->shared_frame);
+    free(sim->sharers);
+    free(sim->private_copy);
+    for (int l = 0; l < RADIX_MAX_LEVELS; l++) {
+        free(sim->radix_nodes[l]);
+    }
+    free(sim->pt_mapped);
+    free(sim->pt_head);
+    free(sim->pt_next);
+    free(sim->huge_mapped);
+    free(sim);
+}
+
+// Function to set up the frame budgets and load control of the allocation mode; returns -1 when memory runs out
+static int init_allocation(simulator *sim)
+{
+    const sim_config *config = &sim->config;
+    int processes = config->processes;
+    int pages = processes * config->pages_per_process;
+    if (config->alloc == ALLOC_LOCAL || config->alloc == ALLOC_GLOBAL) {
+        return 0;
+    }
+
+    sim->budget = calloc(processes, sizeof(int));
+    if (sim->budget == NULL) {
+        return -1;
+    }
+    if (config->alloc == ALLOC_EQUAL || config->alloc == ALLOC_PFF) {
+        // An equal share each; PFF moves frames between processes from there
+        for (int i = 0; i < processes; i++) {
+            sim->budget[i] = sim->frames / processes + (i < sim->frames % processes);
+            sim->demand += sim->budget[i];
+        }
+    }
+    if (config->alloc == ALLOC_PROPORTIONAL) {
+        sim->footprint = calloc(processes, sizeof(int));
+        if (sim->footprint == NULL) {
+            return -1;
+        }
+    }
+    if (config->alloc == ALLOC_WSET) {
+        sim->last_reference = malloc(pages * sizeof(long long));
+        sim->window = malloc(config->wset_window * sizeof(int));
+        sim->working_set = calloc(processes, sizeof(int));
+        if (sim->last_reference == NULL || sim->window == NULL || sim->working_set == NULL) {
+            return -1;
+        }
+        for (int i = 0; i < pages; i++) {
+            sim->last_reference[i] = -1;
+        }
+    }
+    if (config->alloc == ALLOC_PFF) {
+        sim->pff_references = calloc(processes, sizeof(int));
+        sim->pff_faults = calloc(processes, sizeof(int));
+        if (sim->pff_references == NULL || sim->pff_faults == NULL) {
+            return -1;
+        }
+    }
+
+    // Only the working-set and fault-frequency budgets can grow past RAM
+    if (config->load_control && (config->alloc == ALLOC_WSET || config->alloc == ALLOC_PFF)) {
+        sim->suspended = calloc(processes, 1);
+        sim->suspend_order = calloc(processes, sizeof(int));
+        sim->aged_out = calloc(processes, sizeof(int));
+        sim->deferred = calloc(processes, sizeof(request_queue));
+        if (sim->suspended == NULL || sim->suspend_order == NULL || sim->aged_out == NULL ||
+            sim->deferred == NULL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to set up the prefetch state; returns -1 when memory runs out
+static int init_prefetch(simulator *sim)
+{
+    const sim_config *config = &sim->config;
+    int processes = config->processes;
+    if (config->prefetch == PREFETCH_NONE) {
+        return 0;
+    }
+    sim->prefetch_state = calloc((size_t)processes * config->pages_per_process, 1);
+    sim->prefetch_last = malloc(processes * sizeof(int));
+    sim->prefetch_stride = calloc(processes, sizeof(int));
+    sim->prefetch_window = malloc(processes * sizeof(int));
+    if (sim->prefetch_state == NULL || sim->prefetch_last == NULL || sim->prefetch_stride == NULL ||
+        sim->prefetch_window == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < processes; i++) {
+        sim->prefetch_last[i] = -1;
+        sim->prefetch_window[i] = 1;  // Adaptive readahead starts small and earns its window
+    }
+    return 0;
+}
+
+// Function to set up the shared segment; returns -1 when memory runs out
+static int init_sharing(simulator *sim)
+{
+    const sim_config *config = &sim->config;
+    int shared = config->shared_pages;
+    if (shared == 0) {
+        return 0;
+    }
+    sim->RAM.shared = calloc(sim->frames, 1);
+    sim->shared_frame = malloc(shared * sizeof(int));
+    sim->sharers = malloc(shared * sizeof(int));
+    sim->private_copy = calloc((size_t)config->processes * shared, 1);
+    if (sim->RAM.shared == NULL || sim->shared_frame == NULL || sim->sharers == NULL || sim->private_copy == NULL) {
+        return -1;
+    }
+    for (int j = 0; j < shared; j++) {
+        sim->shared_frame[j] = NOT_RESIDENT;
+        sim->sharers[j] = config->processes;
+    }
+    return 0;
+}
 
-memory* RAM[RAM_SIZE];
-memory* VirtualMemory[VM_SIZE];
-int page_table[PROCESSES][PAGES_PER_PROCESS];
+// Function to set up the page-table organization and the huge pages; returns -1 when memory runs out
+static int init_page_table_model(simulator *sim)
+{
+    const sim_config *config = &sim->config;
+    int processes = config->processes;
+    if (config->huge_pages > 0) {
+        sim->huge_mapped = calloc((size_t)processes * (config->huge_pages / config->huge_page_size), 1);
+        if (sim->huge_mapped == NULL) {
+            return -1;
+        }
+    }
 
-int timeStep = 0;  // Tracks the simulation time step
+    switch (config->page_table_kind) {
+    case PT_FLAT:
+        return 0;
+    case PT_HASHED:
+    case PT_INVERTED: {
+        // A chain per frame, rounded up to a power of two; the inverted table links its frames
+        // into the chains, the hashed table an entry for every page walked so far
+        int chains = 2;
+        sim->pt_hash_bits = 1;
+        while (chains < sim->frames) {
+            chains *= 2;
+            sim->pt_hash_bits++;
+        }
+        int entries = config->page_table_kind == PT_HASHED ? processes * config->pages_per_process : sim->frames;
+        sim->pt_head = malloc(chains * sizeof(int));
+        sim->pt_next = malloc(entries * sizeof(int));
+        if (config->page_table_kind == PT_HASHED) {
+            sim->pt_mapped = calloc(entries, 1);
+        }
+        if (sim->pt_head == NULL || sim->pt_next == NULL ||
+            (config->page_table_kind == PT_HASHED && sim->pt_mapped == NULL)) {
+            return -1;
+        }
+        for (int c = 0; c < chains; c++) {
+            sim->pt_head[c] = -1;
+        }
+        return 0;
+    }
+    default:
+        for (int l = 1; l < radix_levels(config); l++) {
+            sim->radix_nodes[l] = calloc((size_t)processes * radix_level_nodes(config, l), 1);
+            if (sim->radix_nodes[l] == NULL) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+}
 
 // Function to initialize virtual memory and page tables
-void initialize_VM()
+simulator *initialize_VM(const sim_config *config)
 {
-    // Initialize virtual memory
-    for (int x = 0; x < VM_SIZE; x += PAGE_FRAME_SIZE)
-    {
-        int processID = x / 8;      // 8 locations per process (as there are 4 pages per process)
-        int pageNum = (x / 2) % 4;
+    simulator *sim = calloc(1, sizeof(simulator));
+    if (sim == NULL) {
+        return NULL;
+    }
+    sim->config = *config;
+
+    // Virtual memory needs no storage of its own: page j of process i is simply (i, j)
+    int pages = config->processes * config->pages_per_process;
+    sim->frames = config->ram_size / PAGE_FRAME_SIZE;
+    sim->RAM.process_id = malloc(sim->frames * sizeof(int));
+    sim->RAM.page_num = calloc(sim->frames, sizeof(int));
+    sim->RAM.last_accessed = calloc(sim->frames, sizeof(long long));
+    sim->RAM.loaded_at = calloc(sim->frames, sizeof(long long));
+    sim->RAM.referenced = calloc(sim->frames, 1);
+    sim->page_table = malloc(pages * sizeof(int));
+    sim->stats = calloc(config->processes, sizeof(process_stats));
+    sim->touched = calloc(pages, 1);
+    int shadow_pages = pages + config->shared_pages;
+    sim->shadow_prev = malloc(shadow_pages * sizeof(int));
+    sim->shadow_next = malloc(shadow_pages * sizeof(int));
+    sim->in_shadow = calloc(shadow_pages, 1);
+    sim->shadow_head = sim->shadow_tail = -1;
+    if (sim->RAM.process_id == NULL || sim->RAM.page_num == NULL || sim->RAM.last_accessed == NULL ||
+        sim->RAM.loaded_at == NULL || sim->RAM.referenced == NULL || sim->page_table == NULL ||
+        sim->stats == NULL || sim->touched == NULL || sim->shadow_prev == NULL || sim->shadow_next == NULL ||
+        sim->in_shadow == NULL) {
+        destroy_VM(sim);
+        return NULL;
+    }
 
-        VirtualMemory[x] = (memory *)malloc(sizeof(memory));
-        VirtualMemory[x]->process_id = processID;
-        VirtualMemory[x]->page_num = pageNum;
-        VirtualMemory[x]->last_accessed = 0; 
+    // Initialize RAM to empty
+    for (int f = 0; f < sim->frames; f++) {
+        sim->RAM.process_id[f] = -1;
+    }
 
-        VirtualMemory[x + 1] = VirtualMemory[x];  // Same page occupies two contiguous slots
+    if (config->tlb_entries > 0) {
+        tlb *t = &sim->tlb;
+        t->ways = config->tlb_ways ? config->tlb_ways : config->tlb_entries;
+        t->sets = config->tlb_entries / t->ways;
+        t->pid = malloc(config->tlb_entries * sizeof(int));
+        t->page_num = calloc(config->tlb_entries, sizeof(int));
+        t->frame = calloc(config->tlb_entries, sizeof(int));
+        t->stamp = calloc(config->tlb_entries, sizeof(long long));
+        if (t->pid == NULL || t->page_num == NULL || t->frame == NULL || t->stamp == NULL) {
+            destroy_VM(sim);
+            return NULL;
+        }
+        for (int e = 0; e < config->tlb_entries; e++) {
+            t->pid[e] = -1;
+        }
+        t->random_state = 2463534242u;
+        t->current_pid = -1;
     }
 
-    // Initialize RAM to NULL (empty)
-    for (int i = 0; i < RAM_SIZE; i++) {
-        RAM[i] = NULL;
+    if (init_allocation(sim) != 0 || init_prefetch(sim) != 0 || init_sharing(sim) != 0 ||
+        init_page_table_model(sim) != 0) {
+        destroy_VM(sim);
+        return NULL;
     }
 
-    // Initialize all pages in virtual memory (page_table[i][j] = 99 means page is in virtual memory)
-    for (int i = 0; i < PROCESSES; i++) {
-        for (int j = 0; j < PAGES_PER_PROCESS; j++) {
-            page_table[i][j] = 99;  // All pages start in virtual memory
+    // Initialize all pages in virtual memory (NOT_RESIDENT means page is in virtual memory)
+    for (int i = 0; i < config->processes * config->pages_per_process; i++) {
+        sim->page_table[i] = NOT_RESIDENT;  // All pages start in virtual memory
+        if (i % config->pages_per_process < config->shared_pages) {
+            sim->page_table[i] = SHARED_MAPPING;  // The segment's pages are the same in every process
         }
     }
+    return sim;
+}
+
+// Age of the page in a frame under the active policy (smaller is a better victim)
+static inline long long frame_age(const simulator *sim, int frame) {
+    return sim->config.policy == POLICY_FIFO ? sim->RAM.loaded_at[frame] : sim->RAM.last_accessed[frame];
+}
+
+// Function to check whether a process holds at least its frame budget and must replace its own pages
+static inline int at_budget(const simulator *sim, int processID) {
+    long held = sim->stats[processID].frames_held;
+    return sim->budget && held > 0 && held >= sim->budget[processID];
+}
+
+// Which frames a victim search may take
+typedef enum { VICTIM_PROCESS, VICTIM_OVER_BUDGET, VICTIM_ANY } victim_scope;
+
+static inline int victim_allowed(const simulator *sim, int owner, victim_scope scope, int processID) {
+    switch (scope) {
+    case VICTIM_PROCESS:
+        return owner == processID;
+    case VICTIM_OVER_BUDGET:
+        return owner != -1 && sim->stats[owner].frames_held > sim->budget[owner];
+    default:
+        return owner != -1;
+    }
 }
 
-// Find the least recently used page for the process (local LRU)
-int find_lru_page(int processID) {
-    int min_time = TIME_MAX;
+static inline int lru_scan(simulator *sim, victim_scope scope, int processID) {
+    long long min_time = TIME_MAX;
     int lru_index = -1;
-    for (int i = 0; i < RAM_SIZE; i += PAGE_FRAME_SIZE) {
-        if (RAM[i] && RAM[i]->process_id == processID && RAM[i]->last_accessed < min_time) {
-            min_time = RAM[i]->last_accessed;
-            lru_index = i;
+    const int *owner = sim->RAM.process_id;
+    for (int f = 0; f < sim->frames; f++) {
+        if (victim_allowed(sim, owner[f], scope, processID) && frame_age(sim, f) < min_time) {
+            min_time = frame_age(sim, f);
+            lru_index = f;
         }
     }
     return lru_index;
 }
 
-// Find the least recently used page globally (global LRU)
-int find_global_lru_page() {
-    int min_time = TIME_MAX;
-    int lru_index = -1;
-    for (int i = 0; i < RAM_SIZE; i += PAGE_FRAME_SIZE) {
-        if (RAM[i] && RAM[i]->last_accessed < min_time) {
-            min_time = RAM[i]->last_accessed;
-            lru_index = i;
+// Find the least recently used page in the scope: the process's own (local LRU),
+// processes above their budget, or any process (global LRU)
+int find_lru_page(simulator *sim, victim_scope scope, int processID) {
+    // A constant scope per call keeps the scan loop free of the scope test
+    switch (scope) {
+    case VICTIM_PROCESS:
+        return lru_scan(sim, VICTIM_PROCESS, processID);
+    case VICTIM_OVER_BUDGET:
+        return lru_scan(sim, VICTIM_OVER_BUDGET, processID);
+    default:
+        return lru_scan(sim, VICTIM_ANY, processID);
+    }
+}
+
+// Second-chance (CLOCK) victim in the scope
+int find_clock_page(simulator *sim, victim_scope scope, int processID) {
+    // Two sweeps are enough: the first clears every reference bit it passes
+    for (int step = 0; step < 2 * sim->frames; step++) {
+        int f = sim->clock_hand;
+        sim->clock_hand = (sim->clock_hand + 1) % sim->frames;
+
+        if (!victim_allowed(sim, sim->RAM.process_id[f], scope, processID)) {
+            continue;
         }
+        if (!sim->RAM.referenced[f]) {
+            return f;
+        }
+        sim->RAM.referenced[f] = 0;  // Give the page a second chance
     }
-    return lru_index;
+    return -1;
 }
 
-// Bring a page from virtual memory to RAM
-void load_page_to_RAM(int processID, int page_num) {
-    int free_index = -1;
+// Pick the frame to evict for a process under the configured policy; *local tells which scope chose it
+int find_victim(simulator *sim, int processID, int *local) {
+    int (*find)(simulator *, victim_scope, int) = sim->config.policy == POLICY_CLOCK ? find_clock_page : find_lru_page;
+    int victim = -1;
+    if (sim->config.alloc == ALLOC_LOCAL || at_budget(sim, processID)) {
+        victim = find(sim, VICTIM_PROCESS, processID);  // Local replacement
+    }
+    *local = victim != -1;
+    if (victim == -1 && sim->budget) {
+        victim = find(sim, VICTIM_OVER_BUDGET, processID);  // Reclaim frames held beyond a budget
+    }
+    if (victim == -1) {
+        victim = find(sim, VICTIM_ANY, processID);  // Global replacement if no local pages
+    }
+    return victim;
+}
 
-    // Check if there is space in RAM
-    for (int i = 0; i < RAM_SIZE; i += PAGE_FRAME_SIZE) {
-        if (RAM[i] == NULL) {
-            free_index = i;
-            break;
+// Find a cached translation; returns the frame, or -1 on a TLB miss
+static int tlb_lookup(simulator *sim, int processID, int page_num) {
+    tlb *t = &sim->tlb;
+    int first = (page_num % t->sets) * t->ways;
+    for (int e = first; e < first + t->ways; e++) {
+        if (t->pid[e] == processID && t->page_num[e] == page_num) {
+            if (sim->config.tlb_policy == TLB_LRU) {
+                t->stamp[e] = sim->timeStep;
+            }
+            return t->frame[e];
         }
     }
+    return -1;
+}
 
-    // If no free space, use LRU policy to evict a page
-    if (free_index == -1) {
-        free_index = find_lru_page(processID);  // Local LRU
-        if (free_index == -1) {
-            free_index = find_global_lru_page();  // Global LRU if no local pages
+// Cache a translation after a page-table walk, replacing an entry of its set if none is free
+static void tlb_insert(simulator *sim, int processID, int page_num, int frame) {
+    tlb *t = &sim->tlb;
+    int first = (page_num % t->sets) * t->ways;
+    int victim = -1;
+    for (int e = first; e < first + t->ways && victim == -1; e++) {
+        if (t->pid[e] == -1) {
+            victim = e;
+        }
+    }
+    if (victim == -1) {
+        if (sim->config.tlb_policy == TLB_RANDOM) {
+            t->random_state ^= t->random_state << 13;
+            t->random_state ^= t->random_state >> 17;
+            t->random_state ^= t->random_state << 5;
+            victim = first + (int)(t->random_state % (unsigned int)t->ways);
+        } else {
+            // LRU and FIFO differ only in when the stamp is refreshed
+            victim = first;
+            for (int e = first + 1; e < first + t->ways; e++) {
+                if (t->stamp[e] < t->stamp[victim]) {
+                    victim = e;
+                }
+            }
         }
+    }
+    t->pid[victim] = processID;
+    t->page_num[victim] = page_num;
+    t->frame[victim] = frame;
+    t->stamp[victim] = sim->timeStep;
+}
 
-        // Evict the page
-        int evicted_process_id = RAM[free_index]->process_id;
-        int evicted_page_num = RAM[free_index]->page_num;
-        page_table[evicted_process_id][evicted_page_num] = 99;  // Mark evicted page as in virtual memory
+// Drop the translation of an evicted page; returns 1 if the TLB held one
+static int tlb_shootdown(simulator *sim, int processID, int page_num) {
+    tlb *t = &sim->tlb;
+    int first = (page_num % t->sets) * t->ways;
+    for (int e = first; e < first + t->ways; e++) {
+        if (t->pid[e] == processID && t->page_num[e] == page_num) {
+            t->pid[e] = -1;
+            return 1;
+        }
     }
+    return 0;
+}
 
-    // Load the new page into RAM
-    for (int i = 0; i < PAGE_FRAME_SIZE; i++) {
-        RAM[free_index + i] = VirtualMemory[processID * PAGES_PER_PROCESS + page_num];
-        RAM[free_index + i]->last_accessed = timeStep;  // Update last access time
+// Drop every cached translation to a shared frame; the sharers' entries all sit in the page's set.
+// Returns how many the TLB held
+static int tlb_shootdown_frame(simulator *sim, int page_num, int frame) {
+    tlb *t = &sim->tlb;
+    int first = (page_num % t->sets) * t->ways;
+    int dropped = 0;
+    for (int e = first; e < first + t->ways; e++) {
+        if (t->pid[e] != -1 && t->page_num[e] == page_num && t->frame[e] == frame) {
+            t->pid[e] = -1;
+            dropped++;
+        }
     }
+    return dropped;
+}
 
-    // Update page table to reflect the new page in RAM
-    page_table[processID][page_num] = free_index / PAGE_FRAME_SIZE;
+// Without ASIDs the TLB cannot tell address spaces apart, so a process switch empties it
+static void tlb_switch_to(simulator *sim, int processID) {
+    tlb *t = &sim->tlb;
+    if (t->current_pid == processID) {
+        return;
+    }
+    if (sim->config.tlb_switch == TLB_FLUSH && t->current_pid != -1) {
+        for (int e = 0; e < t->sets * t->ways; e++) {
+            t->pid[e] = -1;
+        }
+        sim->stats[processID].tlb_flushes++;
+    }
+    t->current_pid = processID;
 }
 
-// Update last access time for the page
-void update_last_access(int processID, int page_num) {
-    for (int i = 0; i < RAM_SIZE; i += PAGE_FRAME_SIZE) {
-        if (RAM[i] && RAM[i]->process_id == processID && RAM[i]->page_num == page_num) {
-            RAM[i]->last_accessed = timeStep;
-            break;
+// Memory references of a page-table walk for the page, made on a TLB miss or, without a TLB, on every
+// request. Flat: its one entry. Radix: an entry per level down to the leaf, or down to the first node
+// not allocated yet; a huge page stops at the level whose entries cover it. Hashed and inverted: the
+// chain head, then every entry up to the page's, or the whole chain when it has none. A huge page
+// has a single entry, under its first page.
+static int page_walk(const simulator *sim, int processID, int page_num) {
+    const sim_config *config = &sim->config;
+    int huge = huge_mapped(sim, processID, page_num);
+    switch (config->page_table_kind) {
+    case PT_FLAT:
+        return 1;
+    case PT_HASHED:
+    case PT_INVERTED: {
+        int pages_per_process = config->pages_per_process;
+        int entry_page = huge ? page_num - page_num % config->huge_page_size : page_num;
+        int key = processID * pages_per_process + entry_page;
+        int references = 1;
+        for (int e = sim->pt_head[pt_hash(sim, key)]; e != -1; e = sim->pt_next[e]) {
+            references++;
+            int page = e;
+            if (config->page_table_kind == PT_INVERTED) {
+                page = sim->RAM.process_id[e] * pages_per_process + sim->RAM.page_num[e];
+            }
+            if (page == key) {
+                break;
+            }
+        }
+        return references;
+    }
+    default: {
+        int levels = radix_levels(config);
+        if (huge) {
+            return levels - huge_page_levels(config);
         }
+        int references = 1;
+        for (int l = 1; l < levels; l++) {
+            int node = processID * radix_level_nodes(config, l) + (page_num >> radix_shift(levels, l));
+            if (!sim->radix_nodes[l][node]) {
+                break;
+            }
+            references++;
+        }
+        return references;
+    }
     }
 }
 
-// Handle page request
-void page_request(int pid) {
-    int page_num = timeStep % PAGES_PER_PROCESS;  // Get the next page for the process
+// Function to give a walked page its page-table entry: a radix table allocates the nodes on the
+// page's path, which for a huge page stops at its entry's level; a hashed table chains a new entry
+static void pt_map(simulator *sim, int processID, int page_num) {
+    const sim_config *config = &sim->config;
+    int huge = huge_mapped(sim, processID, page_num);
+    if (config->page_table_kind == PT_HASHED) {
+        int entry_page = huge ? page_num - page_num % config->huge_page_size : page_num;
+        int page = processID * config->pages_per_process + entry_page;
+        if (!sim->pt_mapped[page]) {
+            int chain = pt_hash(sim, page);
+            sim->pt_mapped[page] = 1;
+            sim->pt_next[page] = sim->pt_head[chain];
+            sim->pt_head[chain] = page;
+        }
+        return;
+    }
+    int levels = radix_levels(config);
+    int last = huge ? levels - huge_page_levels(config) : levels;
+    for (int l = 1; l < last; l++) {
+        sim->radix_nodes[l][processID * radix_level_nodes(config, l) + (page_num >> radix_shift(levels, l))] = 1;
+    }
+}
 
-    // Check if page is already in RAM
-    if (page_table[pid][page_num] == 99) {
-        // Page is in virtual memory, bring it to RAM
-        load_page_to_RAM(pid, page_num);
+// Function to link a frame into the inverted table's chain for the page it was just loaded with
+static void inverted_insert(simulator *sim, int frame) {
+    int chain = pt_hash(sim, sim->RAM.process_id[frame] * sim->config.pages_per_process + sim->RAM.page_num[frame]);
+    sim->pt_next[frame] = sim->pt_head[chain];
+    sim->pt_head[chain] = frame;
+}
+
+// Function to unlink a frame from the inverted table before its page leaves it
+static void inverted_remove(simulator *sim, int frame) {
+    int chain = pt_hash(sim, sim->RAM.process_id[frame] * sim->config.pages_per_process + sim->RAM.page_num[frame]);
+    int *link = &sim->pt_head[chain];
+    while (*link != frame) {
+        link = &sim->pt_next[*link];
     }
+    *link = sim->pt_next[frame];
+}
 
-    // Update last access time
-    update_last_access(pid, page_num);
+// Function to send the page in a frame back to virtual memory; the frame keeps its contents until reused
+static void evict_frame(simulator *sim, int frame) {
+    int evicted_process_id = sim->RAM.process_id[frame];
+    int evicted_page_num = sim->RAM.page_num[frame];
+    if (sim->stream && sim->stream_kind == STREAM_DELTAS) {
+        record_event(sim, 'E', evicted_process_id, evicted_page_num, frame);
+    }
+    if (sim->RAM.shared && sim->RAM.shared[frame]) {
+        // One store unmaps the page from every sharer
+        sim->shared_frame[evicted_page_num] = NOT_RESIDENT;
+        if (sim->tlb.pid) {
+            sim->stats[evicted_process_id].tlb_shootdowns += tlb_shootdown_frame(sim, evicted_page_num, frame);
+        }
+    } else {
+        PAGE_TABLE(sim, evicted_process_id, evicted_page_num) = NOT_RESIDENT;  // Mark evicted page as in virtual memory
+        if (sim->tlb.pid && tlb_shootdown(sim, evicted_process_id, evicted_page_num)) {
+            sim->stats[evicted_process_id].tlb_shootdowns++;
+        }
+    }
+    if (huge_mapped(sim, evicted_process_id, evicted_page_num)) {
+        // Reclaim splits the huge page; the rest of it stays resident as base pages
+        HUGE_MAPPED(sim, evicted_process_id, evicted_page_num) = 0;
+        sim->stats[evicted_process_id].huge_splits++;
+        if (sim->tlb.pid && tlb_shootdown(sim, evicted_process_id, HUGE_TLB_TAG(sim, evicted_page_num))) {
+            sim->stats[evicted_process_id].tlb_shootdowns++;
+        }
+    }
+    if (sim->config.page_table_kind == PT_INVERTED) {
+        inverted_remove(sim, frame);
+    }
+    sim->stats[evicted_process_id].frames_held--;
+    if (sim->prefetch_state) {
+        unsigned char *state = &sim->prefetch_state[evicted_process_id * sim->config.pages_per_process + evicted_page_num];
+        if (*state & PREFETCH_UNUSED) {
+            // Wasted readahead: the adaptive window halves
+            *state &= ~PREFETCH_UNUSED;
+            sim->stats[evicted_process_id].prefetch_unused++;
+            int *window = &sim->prefetch_window[evicted_process_id];
+            *window = *window > 1 ? *window / 2 : 1;
+        }
+    }
+}
 
-    timeStep++;
+// Function to evict the page in a frame and return the frame to the free pool
+static void release_frame(simulator *sim, int frame) {
+    evict_frame(sim, frame);
+    sim->RAM.process_id[frame] = -1;
+    if (frame < sim->first_free) {
+        sim->first_free = frame;
+    }
 }
 
-int main(int argc, char *argv[])
-{
-    if (argc < 3) {
-        fprintf(stderr, "Usage: %s <input_file> <output_file>\n", argv[0]);
-        return EXIT_FAILURE;
+// Function to pick the frame for a page of the process: the first free one, or a victim chosen by
+// the replacement policy. A victim's page is still in it; *local tells which scope chose it
+static int choose_frame(simulator *sim, int processID, int *local) {
+    // Check if there is space in RAM
+    while (sim->first_free < sim->frames && sim->RAM.process_id[sim->first_free] != -1) {
+        sim->first_free++;
+    }
+    if (sim->first_free < sim->frames && !at_budget(sim, processID)) {
+        return sim->first_free;  // A process at its budget may not take a free frame
     }
 
-    initialize_VM();  // Initialize virtual memory and page tables
+    // If no free space, use the replacement policy to evict a page
+    return find_victim(sim, processID, local);
+}
 
-    // Open input file for reading process requests
-    FILE *input_file = fopen(argv[1], "r");
-    if (input_file == NULL) {
-        perror("Error opening input file");
-        return EXIT_FAILURE;
+// Function to load a page into the frame choose_frame picked, evicting the page still in it
+static void fill_frame(simulator *sim, int frame, int local, int processID, int page_num) {
+    if (sim->RAM.process_id[frame] != -1) {
+        evict_frame(sim, frame);
+        if (local) {
+            sim->stats[processID].local_evictions++;
+        } else {
+            sim->stats[processID].global_evictions++;
+        }
     }
+    sim->stats[processID].frames_held++;
 
-    // Read process requests from the input file
-    int processID;
-    while (fscanf(input_file, "%d", &processID) != EOF) {
-        page_request(processID);  // Handle memory access for the process
+    // Load the new page into RAM
+    sim->RAM.process_id[frame] = processID;
+    sim->RAM.page_num[frame] = page_num;
+    sim->RAM.last_accessed[frame] = sim->timeStep;
+    sim->RAM.loaded_at[frame] = sim->timeStep;
+    sim->RAM.referenced[frame] = 0;
+
+    // Update page table to reflect the new page in RAM
+    if (PAGE_TABLE(sim, processID, page_num) == SHARED_MAPPING) {
+        sim->shared_frame[page_num] = frame;  // Resident for every sharer at once
+        sim->RAM.shared[frame] = 1;
+    } else {
+        PAGE_TABLE(sim, processID, page_num) = frame;
+        if (sim->RAM.shared) {
+            sim->RAM.shared[frame] = 0;
+        }
+    }
+    if (sim->config.page_table_kind == PT_INVERTED) {
+        inverted_insert(sim, frame);
     }
-    fclose(input_file);
+    if (sim->stream && sim->stream_kind == STREAM_DELTAS) {
+        record_event(sim, 'L', processID, page_num, frame);
+    }
+}
 
-    // Open output file for writing results
-    FILE *output_file = fopen(argv[2], "w");
-    if (output_file == NULL) {
-        perror("Error opening output file");
-        return EXIT_FAILURE;
+// Bring a page from virtual memory to RAM
+void load_page_to_RAM(simulator *sim, int processID, int page_num) {
+    int local = 0;
+    int frame = choose_frame(sim, processID, &local);
+    fill_frame(sim, frame, local, processID, page_num);
+}
+
+// Update last access time for the page in a frame
+void update_last_access(simulator *sim, int frame) {
+    sim->RAM.last_accessed[frame] = sim->timeStep;
+    sim->RAM.referenced[frame] = 1;
+}
+
+// Function to find a page's shadow entry: a page of the shared segment is one entry for all the
+// processes that map it, so the shadow counts it once, like the single frame it occupies
+static inline int shadow_page(const simulator *sim, int processID, int page_num) {
+    int shared = sim->config.shared_pages;
+    int pages = sim->config.processes * sim->config.pages_per_process;
+    if (page_num < shared && !sim->private_copy[processID * shared + page_num]) {
+        return pages + page_num;
     }
+    return processID * sim->config.pages_per_process + page_num;
+}
 
-    // Print page tables of each process
-    for (int i = 0; i < PROCESSES; i++) {
-        for (int j = 0; j < PAGES_PER_PROCESS; j++) {
-            fprintf(output_file, "%d", page_table[i][j]);
-            if (j < PAGES_PER_PROCESS - 1) {
-                fprintf(output_file, ", ");
-            }
+// Reference a page in the fully associative LRU shadow; returns 1 if the shadow already held it
+static int shadow_access(simulator *sim, int page) {
+    int hit = sim->in_shadow[page];
+    if (hit) {
+        if (sim->shadow_head == page) {
+            return 1;
         }
-        fprintf(output_file, "\n");
+        // Unlink from the middle or the tail
+        int prev = sim->shadow_prev[page];
+        int next = sim->shadow_next[page];
+        sim->shadow_next[prev] = next;
+        if (next != -1) {
+            sim->shadow_prev[next] = prev;
+        } else {
+            sim->shadow_tail = prev;
+        }
+    } else {
+        sim->in_shadow[page] = 1;
+        sim->shadow_count++;
     }
 
-    // Print the content of the RAM
-    for (int i = 0; i < RAM_SIZE; i++) {
-        if (RAM[i]) {
-            fprintf(output_file, "%d,%d,%d", RAM[i]->process_id, RAM[i]->page_num, RAM[i]->last_accessed);
-        } else {
-            fprintf(output_file, "NULL");
+    // Push to the most recently used end
+    sim->shadow_prev[page] = -1;
+    sim->shadow_next[page] = sim->shadow_head;
+    if (sim->shadow_head != -1) {
+        sim->shadow_prev[sim->shadow_head] = page;
+    }
+    sim->shadow_head = page;
+    if (sim->shadow_tail == -1) {
+        sim->shadow_tail = page;
+    }
+
+    // Drop the least recently used page once the shadow is larger than RAM
+    if (sim->shadow_count > sim->config.ram_size / PAGE_FRAME_SIZE) {
+        int lru = sim->shadow_tail;
+        sim->shadow_tail = sim->shadow_prev[lru];
+        sim->shadow_next[sim->shadow_tail] = -1;
+        sim->in_shadow[lru] = 0;
+        sim->shadow_count--;
+    }
+    return hit;
+}
+
+// Function to change a process's frame budget, keeping the demand of the running processes in step
+static void set_budget(simulator *sim, int processID, int frames) {
+    if (!(sim->suspended && sim->suspended[processID])) {
+        sim->demand += frames - sim->budget[processID];
+    }
+    sim->budget[processID] = frames;
+}
+
+// Function to charge a frame to another process, moving the page's prefetch state with it
+static void move_frame_charge(simulator *sim, int frame, int to) {
+    int holder = sim->RAM.process_id[frame];
+    int page_num = sim->RAM.page_num[frame];
+    sim->stats[holder].frames_held--;
+    sim->stats[to].frames_held++;
+    sim->RAM.process_id[frame] = to;
+    if (sim->prefetch_state) {
+        int pages_per_process = sim->config.pages_per_process;
+        sim->prefetch_state[to * pages_per_process + page_num] = sim->prefetch_state[holder * pages_per_process + page_num];
+        sim->prefetch_state[holder * pages_per_process + page_num] = 0;
+    }
+}
+
+// Function to find a running process other than processID that shares the page and still uses it:
+// under wset, has it in its working set, counting the page referenced at this step (current, or -1);
+// under any other allocation, maps it at all. Returns -1 if there is none.
+static int shared_page_user(simulator *sim, int processID, int page_num, int current) {
+    int shared = sim->config.shared_pages;
+    long long oldest = sim->timeStep - sim->config.wset_window;
+    for (int q = 0; q < sim->config.processes; q++) {
+        int page = q * sim->config.pages_per_process + page_num;
+        if (q != processID && !sim->private_copy[q * shared + page_num] &&
+            !(sim->suspended && sim->suspended[q]) &&
+            (sim->last_reference == NULL || page == current || sim->last_reference[page] > oldest)) {
+            return q;
         }
-        if (i % 2 == 1) {
-            fprintf(output_file, "; ");
+    }
+    return -1;
+}
+
+// Slide the working-set window to the current step and add the referenced page (wset).
+// Pages that fall out of their process's working set give their frames back. A shared frame
+// stays while another sharer's working set holds the page; it is charged to that sharer instead.
+static void working_set_access(simulator *sim, int page) {
+    int pages_per_process = sim->config.pages_per_process;
+    int tau = sim->config.wset_window;
+    long long now = sim->timeStep;
+    int slot = (int)(now % tau);
+
+    // The page referenced tau steps ago leaves unless it was referenced since
+    if (now >= tau) {
+        int old = sim->window[slot];
+        if (old != page && sim->last_reference[old] == now - tau) {
+            int pid = old / pages_per_process;
+            int page_num = old % pages_per_process;
+            int frame = page_frame(sim, pid, page_num);
+            if (sim->suspended && sim->suspended[pid]) {
+                sim->aged_out[pid]++;  // A swapped-out process's working set stands still until it resumes
+            } else {
+                set_budget(sim, pid, --sim->working_set[pid]);
+                if (frame != NOT_RESIDENT && sim->RAM.process_id[frame] == pid) {  // Not a shared page another holds
+                    int user = sim->RAM.shared && sim->RAM.shared[frame] ? shared_page_user(sim, pid, page_num, page) : -1;
+                    if (user == -1) {
+                        release_frame(sim, frame);
+                    } else {
+                        move_frame_charge(sim, frame, user);
+                    }
+                }
+            }
         }
     }
-    fprintf(output_file, "\n");
 
-    fclose(output_file);
+    // The window covers steps now - tau + 1 .. now; a reference exactly tau steps back is the slot just reused
+    long long last = sim->last_reference[page];
+    if (last == -1 || last < now - tau) {
+        int pid = page / pages_per_process;
+        set_budget(sim, pid, ++sim->working_set[pid]);
+    }
+    sim->last_reference[page] = now;
+    sim->window[slot] = page;
+}
 
-    return 0;
+// Function to share the frames out in proportion to the pages each process has touched (proportional)
+static void grow_footprint(simulator *sim, int processID) {
+    sim->footprint[processID]++;
+    sim->footprint_total++;
+    for (int i = 0; i < sim->config.processes; i++) {
+        int share = (int)((long)sim->frames * sim->footprint[i] / sim->footprint_total);
+        set_budget(sim, i, share == 0 && sim->footprint[i] > 0 ? 1 : share);
+    }
+}
+
+// Function to note a reference to a page; returns 1 for the first one, which grows a proportional budget
+static inline int touch_page(simulator *sim, int processID, int page) {
+    if (sim->touched[page]) {
+        return 0;
+    }
+    sim->touched[page] = 1;
+    if (sim->config.alloc == ALLOC_PROPORTIONAL) {
+        grow_footprint(sim, processID);
+    }
+    return 1;
+}
+
+// Count a reference in the process's fault-rate window and adjust its budget when the window fills (pff)
+static void pff_access(simulator *sim, int processID, int fault) {
+    sim->pff_references[processID]++;
+    sim->pff_faults[processID] += fault;
+    if (sim->pff_references[processID] < sim->config.pff_window) {
+        return;
+    }
+
+    double rate = (double)sim->pff_faults[processID] / sim->pff_references[processID];
+    int budget = sim->budget[processID];
+    if (rate > sim->config.pff_high && budget < sim->frames) {
+        set_budget(sim, processID, budget + 1);
+    } else if (rate < sim->config.pff_low && budget > 1) {
+        set_budget(sim, processID, budget - 1);
+        // Give back the least useful pages above the new budget
+        while (sim->stats[processID].frames_held > budget - 1) {
+            int frame = sim->config.policy == POLICY_CLOCK ? find_clock_page(sim, VICTIM_PROCESS, processID)
+                                                           : find_lru_page(sim, VICTIM_PROCESS, processID);
+            release_frame(sim, frame);
+        }
+    }
+    sim->pff_references[processID] = 0;
+    sim->pff_faults[processID] = 0;
+}
+
+// Function to read ahead of a demand fault or of the first reference to a prefetched page.
+// next brings in the following prefetch_depth pages; stride and adaptive only follow a
+// distance seen twice in a row, adaptive with the process's own window. Prefetched pages
+// take frames under the replacement policy like demand loads, but never push out a page
+// referenced or loaded at this time step.
+static void prefetch(simulator *sim, int processID, int page_num) {
+    int pages_per_process = sim->config.pages_per_process;
+    int stride = 1;
+    int depth = sim->config.prefetch_depth;
+    if (sim->config.prefetch != PREFETCH_NEXT) {
+        int last = sim->prefetch_last[processID];
+        int distance = last == -1 ? 0 : page_num - last;
+        sim->prefetch_last[processID] = page_num;
+        if (distance == 0 || distance != sim->prefetch_stride[processID]) {
+            sim->prefetch_stride[processID] = distance;
+            return;
+        }
+        stride = distance;
+        if (sim->config.prefetch == PREFETCH_ADAPTIVE) {
+            depth = sim->prefetch_window[processID];
+        }
+    }
+
+    long target = page_num;
+    for (int k = 0; k < depth; k++) {
+        target += stride;
+        if (target < 0 || target >= pages_per_process) {
+            break;
+        }
+        if (page_frame(sim, processID, (int)target) != NOT_RESIDENT) {
+            continue;
+        }
+        int local = 0;
+        int frame = choose_frame(sim, processID, &local);
+        int owner = sim->RAM.process_id[frame];
+        if (owner != -1) {
+            if (sim->RAM.last_accessed[frame] == sim->timeStep) {
+                break;  // Only this step's pages are left to replace
+            }
+            sim->prefetch_state[owner * pages_per_process + sim->RAM.page_num[frame]] |= PREFETCH_DISPLACED;
+        }
+        fill_frame(sim, frame, local, processID, (int)target);
+        sim->prefetch_state[processID * pages_per_process + target] = PREFETCH_UNUSED;
+        sim->stats[processID].prefetches++;
+    }
+}
+
+// Function to handle a write to a copy-on-write page: the process stops sharing it. The last
+// sharer takes the shared frame over as it is; any other gets its own copy in a new frame,
+// or, when the page is out, has its own copy loaded by the fault that follows.
+static void copy_on_write(simulator *sim, int processID, int page_num) {
+    int shared = sim->config.shared_pages;
+    int frame = sim->shared_frame[page_num];
+    if (sim->tlb.pid && tlb_shootdown(sim, processID, page_num)) {
+        sim->stats[processID].tlb_shootdowns++;  // The read-only translation goes
+    }
+    sim->private_copy[processID * shared + page_num] = 1;
+    sim->sharers[page_num]--;
+
+    if (sim->sharers[page_num] == 0) {
+        PAGE_TABLE(sim, processID, page_num) = frame;
+        if (frame != NOT_RESIDENT) {
+            sim->shared_frame[page_num] = NOT_RESIDENT;
+            sim->RAM.shared[frame] = 0;
+            if (sim->RAM.process_id[frame] != processID) {
+                move_frame_charge(sim, frame, processID);  // The frame is charged to the process that loaded it
+            }
+        }
+        return;
+    }
+
+    sim->stats[processID].cow_faults++;
+    PAGE_TABLE(sim, processID, page_num) = NOT_RESIDENT;
+    if (frame != NOT_RESIDENT) {
+        // The source was just referenced, so the search for the copy's frame passes it over
+        sim->RAM.last_accessed[frame] = sim->timeStep;
+        sim->RAM.referenced[frame] = 1;
+        load_page_to_RAM(sim, processID, page_num);
+    }
+}
+
+// Function to map the huge page around a faulting page: the rest of its base pages are loaded with
+// it. If they cannot all be brought in without pushing out a page of this time step, or one of them
+// is pushed out to make room for another, the pages stay base pages, as when no huge page is free.
+static void map_huge(simulator *sim, int processID, int page_num) {
+    int size = sim->config.huge_page_size;
+    int first = page_num - page_num % size;
+    for (int p = first; p < first + size; p++) {
+        if (PAGE_TABLE(sim, processID, p) != NOT_RESIDENT) {
+            continue;
+        }
+        int local = 0;
+        int frame = choose_frame(sim, processID, &local);
+        if (sim->RAM.process_id[frame] != -1 && sim->RAM.last_accessed[frame] == sim->timeStep) {
+            return;
+        }
+        fill_frame(sim, frame, local, processID, p);
+        if (sim->prefetch_state) {
+            sim->prefetch_state[processID * sim->config.pages_per_process + p] = 0;
+        }
+    }
+    for (int p = first; p < first + size; p++) {
+        if (PAGE_TABLE(sim, processID, p) == NOT_RESIDENT) {
+            return;  // An older page of its own was the victim
+        }
+    }
+    HUGE_MAPPED(sim, processID, page_num) = 1;
+    sim->stats[processID].huge_mappings++;
+}
+
+void write_stats_sample(simulator *sim, const char *label);
+void write_stream_snapshot(simulator *sim);
+
+// Function to find which page of the process a pids-format request at this time step names
+int requested_page(const sim_config *config, long timeStep) {
+    return (int)(timeStep % config->pages_per_process);
+}
+
+// Handle page request
+void page_request(simulator *sim, const request *req) {
+    int pid = req->pid;
+    int page_num = req->page_num;
+    int page = pid * sim->config.pages_per_process + page_num;
+    int shadow_hit = shadow_access(sim, shadow_page(sim, pid, page_num));
+    process_stats *stats = &sim->stats[pid];
+    if (sim->config.alloc == ALLOC_WSET) {
+        working_set_access(sim, page);
+    }
+
+    // A write to a copy-on-write page breaks the sharing before the access
+    if (req->write && sim->config.cow && PAGE_TABLE(sim, pid, page_num) == SHARED_MAPPING) {
+        copy_on_write(sim, pid, page_num);
+    }
+
+    // Consult the TLB first; a hit needs no page-table walk
+    int frame = -1;
+    int tlb_hit = 0;
+    if (sim->tlb.pid) {
+        tlb_switch_to(sim, pid);
+        frame = tlb_lookup(sim, pid, page_num);
+        if (frame == -1 && huge_mapped(sim, pid, page_num) && tlb_lookup(sim, pid, HUGE_TLB_TAG(sim, page_num)) != -1) {
+            frame = page_frame(sim, pid, page_num);  // One entry translates the whole huge page
+        }
+        tlb_hit = frame != -1;
+        if (tlb_hit) {
+            stats->tlb_hits++;
+        } else {
+            stats->tlb_misses++;
+        }
+    }
+
+    if (!tlb_hit) {
+        stats->walk_references += page_walk(sim, pid, page_num);
+    }
+
+    // Check if page is already in RAM
+    int fault = 0;
+    int prefetch_hit = 0;
+    if (tlb_hit) {
+        stats->hits++;  // Evictions shoot translations down, so a TLB hit is always resident
+    } else if ((frame = page_frame(sim, pid, page_num)) == NOT_RESIDENT) {
+        // Page is in virtual memory, bring it to RAM
+        fault = 1;
+        if (sim->prefetch_state) {
+            // Pollution only if an LRU RAM without prefetching would still have held the page
+            if ((sim->prefetch_state[page] & PREFETCH_DISPLACED) && shadow_hit) {
+                stats->prefetch_pollution++;
+            }
+            sim->prefetch_state[page] = 0;
+        }
+        int first_touch = touch_page(sim, pid, page);
+        load_page_to_RAM(sim, pid, page_num);
+        if (page_num < sim->config.huge_pages) {
+            map_huge(sim, pid, page_num);
+        }
+        frame = page_frame(sim, pid, page_num);
+        if (first_touch) {
+            stats->compulsory_faults++;
+        } else if (shadow_hit) {
+            stats->conflict_faults++;
+        } else {
+            stats->capacity_faults++;
+        }
+    } else {
+        stats->hits++;
+    }
+    if (!fault && (sim->prefetch_state || sim->shared_frame || sim->huge_mapped)) {
+        touch_page(sim, pid, page);  // Prefetched, shared and huge pages can be hit before they ever fault
+    }
+    if (!fault && sim->prefetch_state && (sim->prefetch_state[page] & PREFETCH_UNUSED)) {
+        // A prefetch paid off: the adaptive window doubles, up to the depth
+        prefetch_hit = 1;
+        sim->prefetch_state[page] = 0;
+        stats->prefetch_hits++;
+        int *window = &sim->prefetch_window[pid];
+        *window = *window * 2 < sim->config.prefetch_depth ? *window * 2 : sim->config.prefetch_depth;
+    }
+    if (sim->stream && sim->stream_kind == STREAM_DELTAS && !fault) {
+        record_event(sim, 'H', pid, page_num, frame);
+    }
+    if (!tlb_hit && (sim->radix_nodes[1] || sim->pt_mapped)) {
+        pt_map(sim, pid, page_num);  // The walk, repeated after a fault, leaves an entry behind
+    }
+    if (sim->tlb.pid && !tlb_hit) {
+        tlb_insert(sim, pid, huge_mapped(sim, pid, page_num) ? HUGE_TLB_TAG(sim, page_num) : page_num, frame);
+    }
+
+    // Update last access time
+    update_last_access(sim, frame);
+    if (sim->prefetch_state && (fault || prefetch_hit)) {
+        prefetch(sim, pid, page_num);
+    }
+    if (sim->config.alloc == ALLOC_PFF) {
+        pff_access(sim, pid, fault);
+    }
+
+    sim->timeStep++;
+    if (sim->sample_interval && sim->timeStep % sim->sample_interval == 0) {
+        write_stats_sample(sim, "sample");
+    }
+    if (sim->stream && sim->stream_kind == STREAM_SNAPSHOTS && sim->timeStep % sim->stream_interval == 0) {
+        write_stream_snapshot(sim);
+    }
+}
+
+// Function to swap a process out: its frames are freed and its requests wait until it resumes
+static void suspend_process(simulator *sim, int processID) {
+    for (int f = 0; f < sim->frames && sim->stats[processID].frames_held > 0; f++) {
+        if (sim->RAM.process_id[f] != processID) {
+            continue;
+        }
+        // A shared frame another running process uses stays resident, charged to that process
+        int user = sim->RAM.shared && sim->RAM.shared[f] ? shared_page_user(sim, processID, sim->RAM.page_num[f], -1) : -1;
+        if (user == -1) {
+            release_frame(sim, f);
+        } else {
+            move_frame_charge(sim, f, user);
+        }
+    }
+    sim->suspended[processID] = 1;
+    sim->demand -= sim->budget[processID];
+    sim->suspend_order[(sim->suspend_head + sim->suspended_count) % sim->config.processes] = processID;
+    sim->suspended_count++;
+    sim->stats[processID].suspensions++;
+}
+
+// Function to resume the longest suspended process and replay the requests it missed
+static void resume_oldest(simulator *sim) {
+    int pid = sim->suspend_order[sim->suspend_head];
+    sim->suspend_head = (sim->suspend_head + 1) % sim->config.processes;
+    sim->suspended_count--;
+    if (sim->aged_out[pid] > 0) {
+        // Pages that passed out of the window while the process was out leave its working set now
+        sim->working_set[pid] -= sim->aged_out[pid];
+        set_budget(sim, pid, sim->working_set[pid]);
+        sim->aged_out[pid] = 0;
+    }
+    sim->suspended[pid] = 0;
+    sim->demand += sim->budget[pid];
+
+    request_queue *q = &sim->deferred[pid];
+    while (q->head < q->length) {
+        page_request(sim, &q->requests[q->head++]);
+    }
+    q->head = q->length = 0;
+}
+
+// Load control: suspend the largest process while the budgets of the running ones exceed RAM,
+// and resume suspended processes, oldest first, once their demand fits again. The demand is the
+// process's budget as it stands now. A suspended process makes no references, so its working
+// set is held as it was, in the process's own time, rather than emptying as the window moves on.
+static void balance_load(simulator *sim) {
+    int running = sim->config.processes - sim->suspended_count;
+    while (sim->demand > sim->frames && running > 1) {
+        int largest = -1;
+        for (int i = 0; i < sim->config.processes; i++) {
+            if (!sim->suspended[i] && (largest == -1 || sim->budget[i] > sim->budget[largest])) {
+                largest = i;
+            }
+        }
+        suspend_process(sim, largest);
+        running--;
+    }
+    while (sim->suspended_count > 0 && sim->demand <= sim->frames &&
+           sim->demand + sim->budget[sim->suspend_order[sim->suspend_head]] <= sim->frames) {
+        resume_oldest(sim);
+    }
+}
+
+// Handle a request from the trace, holding it back if its process is suspended; returns -1 when memory runs out
+int submit_request(simulator *sim, const request *req) {
+    if (sim->suspended == NULL) {
+        page_request(sim, req);
+        return 0;
+    }
+    if (sim->suspended[req->pid]) {
+        request_queue *q = &sim->deferred[req->pid];
+        if (q->length == q->capacity) {
+            int capacity = q->capacity ? q->capacity * 2 : 64;
+            request *grown = realloc(q->requests, capacity * sizeof(request));
+            if (grown == NULL) {
+                return -1;
+            }
+            q->requests = grown;
+            q->capacity = capacity;
+        }
+        q->requests[q->length++] = *req;
+        sim->stats[req->pid].deferred_requests++;
+        return 0;
+    }
+    page_request(sim, req);
+    balance_load(sim);
+    return 0;
+}
+
+// Function to resume every process still suspended at the end of the trace and replay its requests
+void finish_requests(simulator *sim) {
+    while (sim->suspended && sim->suspended_count > 0) {
+        resume_oldest(sim);
+    }
+}
+
+// Function to count every kind of page fault
+long total_faults(const process_stats *stats) {
+    return stats->compulsory_faults + stats->capacity_faults + stats->conflict_faults;
+}
+
+// Function to measure a process's page table: the whole flat table, the allocated radix nodes, its
+// hashed entries, or the inverted entries of the frames it holds
+static long page_table_bytes(const simulator *sim, int processID) {
+    const sim_config *config = &sim->config;
+    int pages_per_process = config->pages_per_process;
+    long entries = 0;
+    switch (config->page_table_kind) {
+    case PT_FLAT:
+        return (long)pages_per_process * PTE_BYTES;
+    case PT_HASHED:
+        for (int j = 0; j < pages_per_process; j++) {
+            entries += sim->pt_mapped[processID * pages_per_process + j];
+        }
+        return entries * HASHED_PTE_BYTES;
+    case PT_INVERTED:
+        return sim->stats[processID].frames_held * HASHED_PTE_BYTES;
+    default: {
+        int levels = radix_levels(config);
+        long nodes = 1;  // The root
+        for (int l = 1; l < levels; l++) {
+            int level_nodes = radix_level_nodes(config, l);
+            for (int n = 0; n < level_nodes; n++) {
+                nodes += sim->radix_nodes[l][processID * level_nodes + n];
+            }
+        }
+        return nodes * ((long)PTE_BYTES << (VPN_BITS / levels));
+    }
+    }
+}
+
+// Function to add the per-process counters into the global ones
+void sum_stats(simulator *sim) {
+    memset(&sim->total, 0, sizeof(sim->total));
+    for (int i = 0; i < sim->config.processes; i++) {
+        process_stats *p = &sim->stats[i];
+        sim->total.hits += p->hits;
+        sim->total.compulsory_faults += p->compulsory_faults;
+        sim->total.capacity_faults += p->capacity_faults;
+        sim->total.conflict_faults += p->conflict_faults;
+        sim->total.local_evictions += p->local_evictions;
+        sim->total.global_evictions += p->global_evictions;
+        sim->total.frames_held += p->frames_held;
+        sim->total.tlb_hits += p->tlb_hits;
+        sim->total.tlb_misses += p->tlb_misses;
+        sim->total.tlb_flushes += p->tlb_flushes;
+        sim->total.tlb_shootdowns += p->tlb_shootdowns;
+        sim->total.suspensions += p->suspensions;
+        sim->total.deferred_requests += p->deferred_requests;
+        sim->total.prefetches += p->prefetches;
+        sim->total.prefetch_hits += p->prefetch_hits;
+        sim->total.prefetch_unused += p->prefetch_unused;
+        sim->total.prefetch_pollution += p->prefetch_pollution;
+        sim->total.cow_faults += p->cow_faults;
+        sim->total.walk_references += p->walk_references;
+        sim->total.huge_mappings += p->huge_mappings;
+        sim->total.huge_splits += p->huge_splits;
+    }
+
+    // A resident shared page saves a frame for every process mapping it beyond the first
+    int shared = sim->config.shared_pages;
+    for (int i = 0; i < sim->config.processes; i++) {
+        sim->stats[i].frames_saved = 0;
+    }
+    for (int j = 0; j < shared && sim->shared_frame; j++) {
+        int frame = sim->shared_frame[j];
+        if (frame == NOT_RESIDENT) {
+            continue;
+        }
+        int holder = sim->RAM.process_id[frame];
+        for (int i = 0; i < sim->config.processes; i++) {
+            int maps = !sim->private_copy[i * shared + j];
+            if (i != holder && maps) {
+                sim->stats[i].frames_saved++;
+            } else if (i == holder && !maps) {
+                sim->stats[i].frames_saved--;  // Holds the frame for the others after copying the page
+            }
+        }
+    }
+    for (int i = 0; i < sim->config.processes; i++) {
+        sim->total.frames_saved += sim->stats[i].frames_saved;
+    }
+
+    for (int i = 0; i < sim->config.processes; i++) {
+        sim->stats[i].page_table_bytes = page_table_bytes(sim, i);
+        sim->total.page_table_bytes += sim->stats[i].page_table_bytes;
+    }
+    if (sim->pt_head) {
+        sim->total.page_table_bytes += (long)HASH_ANCHOR_BYTES << sim->pt_hash_bits;
+    }
+    if (sim->config.page_table_kind == PT_INVERTED) {
+        sim->total.page_table_bytes += (sim->frames - sim->total.frames_held) * HASHED_PTE_BYTES;  // Free frames
+    }
+}
+
+static void write_stats_row(FILE *f, stats_format format, const char *label, long long step, const char *process,
+                            const process_stats *p) {
+    if (format == STATS_CSV) {
+        fprintf(f, "%s,%lld,%s,%ld,%ld", label, step, process, p->hits, total_faults(p));
+        for (int c = 0; c < STATS_COLUMNS; c++) {
+            fprintf(f, ",%ld", STATS_COLUMN(p, c));
+        }
+        fprintf(f, "\n");
+    } else {
+        fprintf(f, "{\"process\": \"%s\", \"hits\": %ld, \"faults\": %ld", process, p->hits, total_faults(p));
+        for (int c = 0; c < STATS_COLUMNS; c++) {
+            fprintf(f, ", \"%s\": %ld", stats_columns[c].name, STATS_COLUMN(p, c));
+        }
+        fprintf(f, "}");
+    }
+}
+
+// Function to write the current counters of every process and the total, tagged as a sample or the final summary
+void write_stats_sample(simulator *sim, const char *label) {
+    FILE *f = sim->stats_file;
+    if (f == NULL) {
+        return;
+    }
+    sum_stats(sim);
+
+    char process[16];
+    if (sim->stats_format == STATS_CSV) {
+        for (int i = 0; i < sim->config.processes; i++) {
+            snprintf(process, sizeof(process), "%d", i);
+            write_stats_row(f, STATS_CSV, label, sim->timeStep, process, &sim->stats[i]);
+        }
+        write_stats_row(f, STATS_CSV, label, sim->timeStep, "all", &sim->total);
+    } else {
+        fprintf(f, "%s\n    {\"type\": \"%s\", \"step\": %lld, \"processes\": [\n",
+                sim->samples_written ? "," : "", label, sim->timeStep);
+        for (int i = 0; i < sim->config.processes; i++) {
+            snprintf(process, sizeof(process), "%d", i);
+            fprintf(f, "      ");
+            write_stats_row(f, STATS_JSON, label, sim->timeStep, process, &sim->stats[i]);
+            fprintf(f, "%s\n", i < sim->config.processes - 1 ? "," : "");
+        }
+        fprintf(f, "    ],\n    \"total\": ");
+        write_stats_row(f, STATS_JSON, label, sim->timeStep, "all", &sim->total);
+        fprintf(f, "}");
+    }
+    sim->samples_written++;
+}
+
+// Function to start the statistics output; samples follow as the simulation runs
+void open_stats(simulator *sim, FILE *f, stats_format format, int sample_interval) {
+    sim->stats_file = f;
+    sim->stats_format = format;
+    sim->sample_interval = sample_interval;
+    if (format == STATS_CSV) {
+        fprintf(f, "type,step,process,hits,faults");
+        for (int c = 0; c < STATS_COLUMNS; c++) {
+            fprintf(f, ",%s", stats_columns[c].name);
+        }
+        fprintf(f, "\n");
+    } else {
+        fprintf(f, "{\"samples\": [");
+    }
+}
+
+// Function to write the final summary and close the statistics output
+void close_stats(simulator *sim) {
+    if (sim == NULL || sim->stats_file == NULL) {
+        return;
+    }
+    write_stats_sample(sim, "final");
+    if (sim->stats_format == STATS_JSON) {
+        fprintf(sim->stats_file, "\n]}\n");
+    }
+    fclose(sim->stats_file);
+    sim->stats_file = NULL;
+}
+
+// Function to write the page tables and RAM contents in the output file format
+static void format_state(const simulator *sim, output_buffer *out) {
+    // Print page tables of each process
+    for (int i = 0; i < sim->config.processes; i++) {
+        for (int j = 0; j < sim->config.pages_per_process; j++) {
+            int frame = page_frame(sim, i, j);
+            out_int(out, frame == NOT_RESIDENT ? IN_VIRTUAL_MEMORY : frame);
+            if (j < sim->config.pages_per_process - 1) {
+                out_bytes(out, ", ", 2);
+            }
+        }
+        out_bytes(out, "\n", 1);
+    }
+
+    // Print the content of the RAM, every frame once per slot it occupies
+    for (int i = 0; i < sim->config.ram_size; i++) {
+        int f = i / PAGE_FRAME_SIZE;
+        if (sim->RAM.process_id[f] != -1) {
+            out_int(out, sim->RAM.process_id[f]);
+            out_bytes(out, ",", 1);
+            out_int(out, sim->RAM.page_num[f]);
+            out_bytes(out, ",", 1);
+            out_int(out, sim->RAM.last_accessed[f]);
+        } else {
+            out_text(out, "NULL");
+        }
+        if (i % 2 == 1) {
+            out_bytes(out, "; ", 2);
+        }
+    }
+    out_bytes(out, "\n", 1);
+}
+
+// Function to write the final state to the output file; returns -1 on a write error
+int write_state(const simulator *sim, FILE *output_file) {
+    char data[WRITE_BUFFER_SIZE / 16];
+    output_buffer out = { output_file, data, 0, sizeof(data), 0 };
+    format_state(sim, &out);
+    out_flush(&out);
+    return out.failed ? -1 : 0;
+}
+
+// Function to append a full snapshot of the page tables and frames to the stream
+void write_stream_snapshot(simulator *sim) {
+    output_buffer *out = sim->stream;
+    if (sim->stream_format == STREAM_TEXT) {
+        out_text(out, "# step ");
+        out_int(out, sim->timeStep);
+        out_bytes(out, "\n", 1);
+        format_state(sim, out);
+        return;
+    }
+    int pages = sim->config.processes * sim->config.pages_per_process;
+    out_bytes(out, "S", 1);
+    out_bytes(out, &sim->timeStep, sizeof(long long));
+    if (sim->shared_frame == NULL) {
+        out_bytes(out, sim->page_table, pages * sizeof(int));
+    } else {
+        for (int i = 0; i < pages; i++) {
+            int frame = page_frame(sim, i / sim->config.pages_per_process, i % sim->config.pages_per_process);
+            out_bytes(out, &frame, sizeof(int));
+        }
+    }
+    out_bytes(out, sim->RAM.process_id, sim->frames * sizeof(int));
+    out_bytes(out, sim->RAM.page_num, sim->frames * sizeof(int));
+    out_bytes(out, sim->RAM.last_accessed, sim->frames * sizeof(long long));
+}
+
+// Function to start streaming the run to f; returns -1 when memory runs out.
+// A binary stream starts with STREAM_MAGIC and the geometry as native ints
+// (processes, pages per process, frames). Each record is a type byte and the step
+// as a native long long, followed by native ints: pid, page and frame for 'L', 'E'
+// and 'H'; for 'S' the page tables, the owner and page of every frame, then the
+// last access of every frame as long longs.
+int open_stream(simulator *sim, FILE *f, stream_kind kind, stream_format format, int interval) {
+    output_buffer *out = malloc(sizeof(output_buffer));
+    char *data = malloc(WRITE_BUFFER_SIZE);
+    if (out == NULL || data == NULL) {
+        free(out);
+        free(data);
+        return -1;
+    }
+    *out = (output_buffer){ f, data, 0, WRITE_BUFFER_SIZE, 0 };
+    sim->stream = out;
+    sim->stream_kind = kind;
+    sim->stream_format = format;
+    sim->stream_interval = interval;
+    if (format == STREAM_BINARY) {
+        int geometry[3] = { sim->config.processes, sim->config.pages_per_process, sim->frames };
+        out_bytes(out, STREAM_MAGIC, sizeof(STREAM_MAGIC) - 1);
+        out_bytes(out, geometry, sizeof(geometry));
+    }
+    return 0;
+}
+
+// Function to flush and close the stream; returns -1 if any write failed
+int close_stream(simulator *sim) {
+    if (sim == NULL || sim->stream == NULL) {
+        return 0;
+    }
+    output_buffer *out = sim->stream;
+    out_flush(out);
+    int failed = out->failed || (out->file == stdout ? fflush(out->file) : fclose(out->file)) != 0;
+    free(out->data);
+    free(out);
+    sim->stream = NULL;
+    return failed ? -1 : 0;
+}
+
+// Function to check that a process id names a process of the simulation
+int valid_process(const sim_config *config, int processID) {
+    return processID >= 0 && processID < config->processes;
+}
+
+// Function to open a trace for reading; "-" reads the standard input
+trace_reader *open_trace(const char *filename, const sim_config *config, trace_format format) {
+    trace_reader *r = malloc(sizeof(trace_reader));
+    if (r == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return NULL;
+    }
+    r->file = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+    if (r->file == NULL) {
+        perror("Error opening input file");
+        free(r);
+        return NULL;
+    }
+    r->filename = filename;
+    r->config = *config;
+    r->format = format;
+    r->length = 0;
+    r->pos = 0;
+    r->offset = 0;
+    r->count = 0;
+    r->line = 1;
+    return r;
+}
+
+void close_trace(trace_reader *r) {
+    if (r == NULL) {
+        return;
+    }
+    if (r->file != stdin) {
+        fclose(r->file);
+    }
+    free(r);
+}
+
+// Next unparsed byte of the trace, or EOF
+static inline int reader_peek(trace_reader *r) {
+    if (r->pos == r->length) {
+        r->offset += r->length;
+        r->length = fread(r->buffer, 1, READ_BUFFER_SIZE, r->file);
+        r->pos = 0;
+        if (r->length == 0) {
+            return EOF;
+        }
+    }
+    return (unsigned char)r->buffer[r->pos];
+}
+
+// Parse an unsigned decimal number; values past INT_MAX saturate so range checks reject them
+static int reader_number(trace_reader *r, int *value) {
+    int c = reader_peek(r);
+    if (c < '0' || c > '9') {
+        return -1;
+    }
+    long n = 0;
+    while (c >= '0' && c <= '9') {
+        if (n <= INT_MAX) {
+            n = n * 10 + (c - '0');
+        }
+        r->pos++;
+        c = reader_peek(r);
+    }
+    *value = n > INT_MAX ? INT_MAX : (int)n;
+    return 0;
+}
+
+static void reader_skip_blanks(trace_reader *r) {
+    int c;
+    while ((c = reader_peek(r)) == ' ' || c == '\t' || c == '\r') {
+        r->pos++;
+    }
+}
+
+static int reader_error(trace_reader *r, const char *message) {
+    if (r->format == TRACE_RECORDS) {
+        fprintf(stderr, "%s in %s at line %ld\n", message, r->filename, r->line);
+    } else {
+        fprintf(stderr, "%s in %s at request %ld\n", message, r->filename, r->count);
+    }
+    return -1;
+}
+
+// Function to read the next request; returns 1 for a request, 0 at the end of the trace, -1 on bad input
+int read_request(trace_reader *r, request *req) {
+    for (;;) {
+        reader_skip_blanks(r);
+        int c = reader_peek(r);
+        if (c == EOF) {
+            return 0;
+        }
+        if (c == '\n') {
+            r->line++;
+            r->pos++;
+            continue;
+        }
+        if (c == '#' && r->format == TRACE_RECORDS) {
+            while ((c = reader_peek(r)) != EOF && c != '\n') {
+                r->pos++;
+            }
+            continue;
+        }
+        break;
+    }
+
+    if (reader_number(r, &req->pid) != 0) {
+        return reader_error(r, "Invalid character");
+    }
+    if (!valid_process(&r->config, req->pid)) {
+        return reader_error(r, "Invalid process id");
+    }
+    req->write = 0;
+
+    if (r->format == TRACE_PIDS) {
+        req->page_num = requested_page(&r->config, r->count);
+    } else {
+        reader_skip_blanks(r);
+        if (reader_number(r, &req->page_num) != 0) {
+            return reader_error(r, "Missing page number");
+        }
+        if (req->page_num >= r->config.pages_per_process) {
+            return reader_error(r, "Invalid page number");
+        }
+        reader_skip_blanks(r);
+        int c = reader_peek(r);
+        if (c == 'r' || c == 'R' || c == 'w' || c == 'W') {
+            req->write = c == 'w' || c == 'W';
+            r->pos++;
+            reader_skip_blanks(r);
+            c = reader_peek(r);
+        }
+        if (c != '\n' && c != EOF) {
+            return reader_error(r, "Invalid record");
+        }
+    }
+    r->count++;
+    return 1;
+}
+
+// Function to read a whole trace into memory once
+int load_trace(const char *filename, const sim_config *config, trace_format format, trace *tr) {
+    tr->requests = NULL;
+    tr->length = 0;
+
+    trace_reader *r = open_trace(filename, config, format);
+    if (r == NULL) {
+        return -1;
+    }
+    long capacity = 0;
+    request req;
+    int status;
+    while ((status = read_request(r, &req)) == 1) {
+        if (tr->length == capacity) {
+            capacity = capacity ? 2 * capacity : 4096;
+            request *grown = realloc(tr->requests, capacity * sizeof(request));
+            if (grown == NULL) {
+                fprintf(stderr, "Out of memory loading %s\n", filename);
+                status = -1;
+                break;
+            }
+            tr->requests = grown;
+        }
+        tr->requests[tr->length++] = req;
+    }
+    close_trace(r);
+
+    if (status != 0) {
+        free(tr->requests);
+        tr->requests = NULL;
+        tr->length = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// Function to continue a trace from a position saved in a snapshot; returns -1 if the trace ends first
+int seek_trace(trace_reader *r, long long offset, long count, long line) {
+    // Seeking past the end of a file succeeds, so read back the byte before the offset
+    if (offset > 0 && fseeko(r->file, offset - 1, SEEK_SET) == 0) {
+        if (fgetc(r->file) == EOF) {
+            fprintf(stderr, "%s ends before the snapshot's position\n", r->filename);
+            return -1;
+        }
+    } else if (offset > 0) {
+        // A pipe cannot seek: read our way up to the offset instead
+        long long skipped = 0;
+        while (skipped < offset) {
+            size_t want = offset - skipped < READ_BUFFER_SIZE ? (size_t)(offset - skipped) : READ_BUFFER_SIZE;
+            size_t got = fread(r->buffer, 1, want, r->file);
+            if (got == 0) {
+                fprintf(stderr, "%s ends before the snapshot's position\n", r->filename);
+                return -1;
+            }
+            skipped += got;
+        }
+    }
+    r->offset = offset;
+    r->length = 0;
+    r->pos = 0;
+    r->count = count;
+    r->line = line;
+    return 0;
+}
+
+// Snapshot layout: SNAPSHOT_MAGIC, the configuration and trace format, every piece of
+// simulator state in the order transfer_state lists it, then the trace position.
+// Values are stored in this machine's byte order and read back by the same build.
+
+// Function to write or read one block of a snapshot; returns -1 on a short transfer
+static int transfer(FILE *f, int save, void *data, size_t size) {
+    if (data == NULL || size == 0) {
+        return 0;  // State the configuration does not use
+    }
+    size_t done = save ? fwrite(data, 1, size, f) : fread(data, 1, size, f);
+    return done == size ? 0 : -1;
+}
+
+// Function to save or load the simulator state in one fixed order; loading fills a simulator
+// freshly built from the same configuration. Returns -1 on a short transfer or out of memory.
+static int transfer_state(simulator *sim, FILE *f, int save) {
+    const sim_config *config = &sim->config;
+    size_t frames = sim->frames;
+    size_t pages = (size_t)config->processes * config->pages_per_process;
+    size_t processes = config->processes;
+    size_t entries = sim->tlb.pid ? config->tlb_entries : 0;
+    int failed = 0;
+
+    failed |= transfer(f, save, sim->RAM.process_id, frames * sizeof(int));
+    failed |= transfer(f, save, sim->RAM.page_num, frames * sizeof(int));
+    failed |= transfer(f, save, sim->RAM.last_accessed, frames * sizeof(long long));
+    failed |= transfer(f, save, sim->RAM.loaded_at, frames * sizeof(long long));
+    failed |= transfer(f, save, sim->RAM.referenced, frames);
+    failed |= transfer(f, save, &sim->first_free, sizeof(int));
+    failed |= transfer(f, save, sim->page_table, pages * sizeof(int));
+    failed |= transfer(f, save, &sim->timeStep, sizeof(long long));
+    failed |= transfer(f, save, &sim->clock_hand, sizeof(int));
+
+    failed |= transfer(f, save, sim->tlb.pid, entries * sizeof(int));
+    failed |= transfer(f, save, sim->tlb.page_num, entries * sizeof(int));
+    failed |= transfer(f, save, sim->tlb.frame, entries * sizeof(int));
+    failed |= transfer(f, save, sim->tlb.stamp, entries * sizeof(long long));
+    failed |= transfer(f, save, &sim->tlb.random_state, sizeof(unsigned int));
+    failed |= transfer(f, save, &sim->tlb.current_pid, sizeof(int));
+
+    failed |= transfer(f, save, sim->stats, processes * sizeof(process_stats));
+    failed |= transfer(f, save, sim->touched, pages);
+    size_t shadow_pages = pages + config->shared_pages;
+    failed |= transfer(f, save, sim->shadow_prev, shadow_pages * sizeof(int));
+    failed |= transfer(f, save, sim->shadow_next, shadow_pages * sizeof(int));
+    failed |= transfer(f, save, sim->in_shadow, shadow_pages);
+    failed |= transfer(f, save, &sim->shadow_head, sizeof(int));
+    failed |= transfer(f, save, &sim->shadow_tail, sizeof(int));
+    failed |= transfer(f, save, &sim->shadow_count, sizeof(int));
+
+    if (sim->budget) {
+        failed |= transfer(f, save, sim->budget, processes * sizeof(int));
+        failed |= transfer(f, save, &sim->demand, sizeof(long));
+        failed |= transfer(f, save, sim->footprint, processes * sizeof(int));
+        failed |= transfer(f, save, &sim->footprint_total, sizeof(int));
+        failed |= transfer(f, save, sim->last_reference, sim->last_reference ? pages * sizeof(long long) : 0);
+        failed |= transfer(f, save, sim->window, sim->window ? config->wset_window * sizeof(int) : 0);
+        failed |= transfer(f, save, sim->working_set, processes * sizeof(int));
+        failed |= transfer(f, save, sim->pff_references, processes * sizeof(int));
+        failed |= transfer(f, save, sim->pff_faults, processes * sizeof(int));
+    }
+
+    if (sim->suspended) {
+        failed |= transfer(f, save, sim->suspended, processes);
+        failed |= transfer(f, save, sim->suspend_order, processes * sizeof(int));
+        failed |= transfer(f, save, sim->aged_out, processes * sizeof(int));
+        failed |= transfer(f, save, &sim->suspend_head, sizeof(int));
+        failed |= transfer(f, save, &sim->suspended_count, sizeof(int));
+
+        // Only the requests still waiting are kept
+        for (size_t i = 0; i < processes && !failed; i++) {
+            request_queue *q = &sim->deferred[i];
+            int waiting = q->length - q->head;
+            failed |= transfer(f, save, &waiting, sizeof(int));
+            if (save) {
+                failed |= transfer(f, save, q->requests + q->head, waiting * sizeof(request));
+            } else if (!failed && waiting > 0) {
+                q->requests = malloc(waiting * sizeof(request));
+                if (q->requests == NULL) {
+                    return -1;
+                }
+                q->head = 0;
+                q->length = q->capacity = waiting;
+                failed |= transfer(f, save, q->requests, waiting * sizeof(request));
+            }
+        }
+    }
+
+    if (sim->prefetch_state) {
+        failed |= transfer(f, save, sim->prefetch_state, pages);
+        failed |= transfer(f, save, sim->prefetch_last, processes * sizeof(int));
+        failed |= transfer(f, save, sim->prefetch_stride, processes * sizeof(int));
+        failed |= transfer(f, save, sim->prefetch_window, processes * sizeof(int));
+    }
+
+    if (sim->shared_frame) {
+        size_t shared = config->shared_pages;
+        failed |= transfer(f, save, sim->RAM.shared, frames);
+        failed |= transfer(f, save, sim->shared_frame, shared * sizeof(int));
+        failed |= transfer(f, save, sim->sharers, shared * sizeof(int));
+        failed |= transfer(f, save, sim->private_copy, processes * shared);
+    }
+
+    for (int l = 1; l < RADIX_MAX_LEVELS && sim->radix_nodes[l]; l++) {
+        failed |= transfer(f, save, sim->radix_nodes[l], processes * radix_level_nodes(config, l));
+    }
+    if (sim->pt_head) {
+        size_t entries = config->page_table_kind == PT_HASHED ? pages : frames;
+        failed |= transfer(f, save, sim->pt_mapped, sim->pt_mapped ? pages : 0);
+        failed |= transfer(f, save, sim->pt_head, ((size_t)1 << sim->pt_hash_bits) * sizeof(int));
+        failed |= transfer(f, save, sim->pt_next, entries * sizeof(int));
+    }
+    if (sim->huge_mapped) {
+        failed |= transfer(f, save, sim->huge_mapped, processes * (config->huge_pages / config->huge_page_size));
+    }
+    return failed ? -1 : 0;
+}
+
+// Function to write a snapshot of the simulator and the trace position. The snapshot is written
+// beside the target and renamed over it, so an interrupted write keeps the previous one.
+int save_snapshot(simulator *sim, const trace_reader *r, const char *path) {
+    size_t length = strlen(path);
+    char *temporary = malloc(length + 5);
+    if (temporary == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    memcpy(temporary, path, length);
+    memcpy(temporary + length, ".tmp", 5);
+
+    FILE *f = fopen(temporary, "wb");
+    if (f == NULL) {
+        perror("Error opening snapshot file");
+        free(temporary);
+        return -1;
+    }
+    long long offset = r->offset + (long long)r->pos;  // Next unparsed byte
+    long count = r->count;
+    long line = r->line;
+    trace_format format = r->format;
+    int failed = transfer(f, 1, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    failed |= transfer(f, 1, &sim->config, sizeof(sim_config));
+    failed |= transfer(f, 1, &format, sizeof(trace_format));
+    failed |= transfer_state(sim, f, 1);
+    failed |= transfer(f, 1, &offset, sizeof(long long));
+    failed |= transfer(f, 1, &count, sizeof(long));
+    failed |= transfer(f, 1, &line, sizeof(long));
+    failed |= fclose(f) != 0;
+    if (failed || rename(temporary, path) != 0) {
+        perror("Error writing snapshot file");
+        remove(temporary);
+        free(temporary);
+        return -1;
+    }
+    free(temporary);
+    return 0;
+}
+
+// Function to check that a snapshot's configuration matches this run: the frame table, recency
+// state and budgets it holds only mean something under the policy and allocation that built them
+static int same_config(const sim_config *a, const sim_config *b) {
+    return a->ram_size == b->ram_size && a->processes == b->processes &&
+           a->pages_per_process == b->pages_per_process && a->policy == b->policy && a->alloc == b->alloc &&
+           a->tlb_entries == b->tlb_entries && a->tlb_ways == b->tlb_ways && a->tlb_policy == b->tlb_policy &&
+           a->tlb_switch == b->tlb_switch && a->wset_window == b->wset_window &&
+           a->pff_window == b->pff_window && a->pff_low == b->pff_low && a->pff_high == b->pff_high &&
+           a->load_control == b->load_control && a->prefetch == b->prefetch &&
+           a->prefetch_depth == b->prefetch_depth && a->shared_pages == b->shared_pages && a->cow == b->cow &&
+           a->page_table_kind == b->page_table_kind && a->huge_pages == b->huge_pages &&
+           a->huge_page_size == b->huge_page_size;
+}
+
+// Function to rebuild a simulator from a snapshot and move the trace to where it was taken.
+// The configuration must match the snapshot's. Returns NULL on any error.
+simulator *load_snapshot(const char *path, const sim_config *config, trace_reader *r) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror("Error opening snapshot file");
+        return NULL;
+    }
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    sim_config saved;
+    trace_format format;
+    if (transfer(f, 0, magic, sizeof(magic)) != 0 || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0 ||
+        transfer(f, 0, &saved, sizeof(saved)) != 0 || transfer(f, 0, &format, sizeof(format)) != 0) {
+        fprintf(stderr, "%s is not a snapshot of this simulator\n", path);
+        fclose(f);
+        return NULL;
+    }
+    if (!same_config(&saved, config) || format != r->format) {
+        fprintf(stderr, "%s was taken with different options; resume with the options of the original run\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    simulator *sim = initialize_VM(config);
+    long long offset;
+    long count, line;
+    int failed = sim == NULL || transfer_state(sim, f, 0) != 0 || transfer(f, 0, &offset, sizeof(long long)) != 0 ||
+                 transfer(f, 0, &count, sizeof(long)) != 0 || transfer(f, 0, &line, sizeof(long)) != 0;
+    fclose(f);
+    if (failed) {
+        fprintf(stderr, "%s is truncated or memory ran out\n", path);
+        destroy_VM(sim);
+        return NULL;
+    }
+    if (seek_trace(r, offset, count, line) != 0) {
+        destroy_VM(sim);
+        return NULL;
+    }
+    return sim;
+}
+
+// One simulator run of a sweep and the counters it finished with
+typedef struct sweep_job
+{
+    sim_config config;
+    process_stats total;
+    int failed;
+} sweep_job;
+
+// Double-ended job queue owned by one worker; the owner pops the tail, thieves take the head
+typedef struct job_queue
+{
+    pthread_mutex_t lock;
+    int *jobs;
+    int head;
+    int tail;
+} job_queue;
+
+typedef struct sweep_pool
+{
+    const trace *tr;
+    sweep_job *jobs;
+    job_queue *queues;
+    int workers;
+} sweep_pool;
+
+typedef struct sweep_worker
+{
+    sweep_pool *pool;
+    int id;
+} sweep_worker;
+
+// Take a job from the worker's own queue, or steal one from another worker
+static int next_job(sweep_pool *pool, int id) {
+    job_queue *own = &pool->queues[id];
+    int job = -1;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->head < own->tail) {
+        job = own->jobs[--own->tail];
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    // Nothing left locally: steal the oldest job of the next busy worker
+    for (int k = 1; job == -1 && k < pool->workers; k++) {
+        job_queue *victim = &pool->queues[(id + k) % pool->workers];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail) {
+            job = victim->jobs[victim->head++];
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return job;
+}
+
+// Replay the shared trace against one configuration
+static void run_sweep_job(const trace *tr, sweep_job *job) {
+    simulator *sim = initialize_VM(&job->config);
+    if (sim == NULL) {
+        job->failed = 1;
+        return;
+    }
+    for (long i = 0; i < tr->length; i++) {
+        if (submit_request(sim, &tr->requests[i]) != 0) {
+            job->failed = 1;
+            destroy_VM(sim);
+            return;
+        }
+    }
+    finish_requests(sim);
+    sum_stats(sim);
+    job->total = sim->total;
+    destroy_VM(sim);
+}
+
+static void *sweep_worker_main(void *arg) {
+    sweep_worker *worker = arg;
+    int job;
+    while ((job = next_job(worker->pool, worker->id)) != -1) {
+        run_sweep_job(worker->pool->tr, &worker->pool->jobs[job]);
+    }
+    return NULL;
+}
+
+// Run every job on a work-stealing pool of threads
+int run_sweep(const trace *tr, sweep_job *jobs, int job_count, int threads) {
+    if (threads > job_count) {
+        threads = job_count;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    sweep_pool pool = { tr, jobs, calloc(threads, sizeof(job_queue)), threads };
+    sweep_worker *workers = calloc(threads, sizeof(sweep_worker));
+    pthread_t *tids = calloc(threads, sizeof(pthread_t));
+    if (pool.queues == NULL || workers == NULL || tids == NULL) {
+        free(pool.queues);
+        free(workers);
+        free(tids);
+        return -1;
+    }
+
+    // Deal the jobs round-robin; stealing evens out the uneven run times
+    for (int w = 0; w < threads; w++) {
+        pthread_mutex_init(&pool.queues[w].lock, NULL);
+        pool.queues[w].jobs = malloc((job_count / threads + 1) * sizeof(int));
+    }
+    for (int j = 0; j < job_count; j++) {
+        job_queue *q = &pool.queues[j % threads];
+        q->jobs[q->tail++] = j;
+    }
+
+    int started = 0;
+    for (int w = 0; w < threads; w++) {
+        workers[w].pool = &pool;
+        workers[w].id = w;
+        if (w > 0 && pthread_create(&tids[w], NULL, sweep_worker_main, &workers[w]) != 0) {
+            break;  // The threads already running steal what this one would have done
+        }
+        started = w + 1;
+    }
+    sweep_worker_main(&workers[0]);  // The calling thread is worker 0
+    for (int w = 1; w < started; w++) {
+        pthread_join(tids[w], NULL);
+    }
+
+    for (int w = 0; w < threads; w++) {
+        pthread_mutex_destroy(&pool.queues[w].lock);
+        free(pool.queues[w].jobs);
+    }
+    free(pool.queues);
+    free(workers);
+    free(tids);
+    return 0;
+}
+
+// Function to write the sweep results as one table
+void write_sweep_table(const trace *tr, const sweep_job *jobs, int job_count, FILE *output_file) {
+    fprintf(output_file, "%-8s %-6s %-12s %6s %-14s %-12s %12s %12s %12s %12s %12s %12s %12s %12s %10s %12s %11s %11s"
+            " %11s %12s %12s %12s %12s %11s %11s\n",
+            "ram_size", "policy", "alloc", "tlb", "page_table", "prefetch", "requests", "hits", "faults", "compulsory",
+            "capacity", "conflict", "local_evict", "global_evict", "fault_rate", "tlb_hit_rate", "pf_accuracy",
+            "pf_coverage", "pf_pollution", "cow_faults", "frames_saved", "walk_refs", "pt_bytes", "huge_maps",
+            "huge_splits");
+    for (int j = 0; j < job_count; j++) {
+        const sweep_job *job = &jobs[j];
+        char prefetch[32];
+        if (job->config.prefetch == PREFETCH_NONE) {
+            snprintf(prefetch, sizeof(prefetch), "none");
+        } else {
+            snprintf(prefetch, sizeof(prefetch), "%s/%d", prefetch_names[job->config.prefetch],
+                     job->config.prefetch_depth);
+        }
+        char page_table[32];  // The organization, and the pages backed by huge pages
+        if (job->config.huge_pages == 0) {
+            snprintf(page_table, sizeof(page_table), "%s", page_table_names[job->config.page_table_kind]);
+        } else {
+            snprintf(page_table, sizeof(page_table), "%s+h%d", page_table_names[job->config.page_table_kind],
+                     job->config.huge_pages);
+        }
+        if (job->failed) {
+            fprintf(output_file, "%-8d %-6s %-12s %6d %-14s %-12s %s\n", job->config.ram_size,
+                    policy_names[job->config.policy], alloc_names[job->config.alloc], job->config.tlb_entries,
+                    page_table, prefetch, "out of memory");
+            continue;
+        }
+        // Accuracy: prefetches that were used; coverage: misses they removed;
+        // pollution: faults on pages they pushed out that LRU alone would have kept, as a share of all faults
+        const process_stats *t = &job->total;
+        long lookups = t->tlb_hits + t->tlb_misses;
+        long faults = total_faults(t);
+        fprintf(output_file,
+                "%-8d %-6s %-12s %6d %-14s %-12s %12ld %12ld %12ld %12ld %12ld %12ld %12ld %12ld %10.6f %12.6f %11.6f"
+                " %11.6f %11.6f %12ld %12ld %12ld %12ld %11ld %11ld\n",
+                job->config.ram_size, policy_names[job->config.policy], alloc_names[job->config.alloc],
+                job->config.tlb_entries, page_table, prefetch, tr->length, t->hits, faults, t->compulsory_faults,
+                t->capacity_faults, t->conflict_faults, t->local_evictions, t->global_evictions,
+                tr->length ? (double)faults / tr->length : 0.0,
+                lookups ? (double)t->tlb_hits / lookups : 0.0,
+                t->prefetches ? (double)t->prefetch_hits / t->prefetches : 0.0,
+                t->prefetch_hits + faults ? (double)t->prefetch_hits / (t->prefetch_hits + faults) : 0.0,
+                faults ? (double)t->prefetch_pollution / faults : 0.0, t->cow_faults, t->frames_saved,
+                t->walk_references, t->page_table_bytes, t->huge_mappings, t->huge_splits);
+    }
+}
+
+// Frame table shared by the CPU threads of a parallel run. Every field is an
+// atomic, but the table is not lock-free: FRAME_BUSY is a per-frame spinlock.
+// A CPU takes it with a CAS on the owner word before it evicts or fills the
+// frame, and a CPU that finds its page's frame busy yields until the holder
+// is done. A holder that is descheduled stalls every CPU waiting on its frame.
+typedef struct shared_memory
+{
+    sim_config config;
+    int frames;
+    _Atomic int *owner;                // page (pid * pages_per_process + page) held, -1 free, FRAME_BUSY
+    _Atomic long long *last_accessed;  // (LRU)
+    _Atomic unsigned char *referenced; // reference bit (CLOCK)
+    _Atomic int *page_table;
+    _Atomic unsigned long clock_hand;  // never wraps in practice, so hand % frames stays in order
+    _Atomic int next_free;             // frames below it have been handed out
+    _Atomic long long time;            // coarse LRU clock, advanced LRU_STAMP_BATCH requests at a time
+    _Atomic long next_ticket;          // trace position allowed to run next (deterministic)
+    _Atomic int start;                 // 1 once every CPU thread exists, -1 to give up
+    int deterministic;
+} shared_memory;
+
+// Counters of one simulated CPU
+typedef struct cpu_stats
+{
+    long requests;
+    long hits;
+    long faults;
+    long evictions;
+    long cas_failures;        // frames another CPU claimed between the choice and the CAS
+} cpu_stats;
+
+// One simulated CPU: a thread replaying the requests of the processes scheduled on it
+typedef struct cpu_thread
+{
+    shared_memory *mem;
+    int id;
+    request *requests;        // requests of pids p with p % cpus == id, in trace order
+    long *ticket;             // trace position of each request (deterministic)
+    long length;
+    unsigned int random_state;   // xorshift32 state for the LRU samples
+    int unstamped;            // requests served since this CPU last advanced the LRU clock
+    cpu_stats stats;
+} cpu_thread;
+
+// Function to release a shared frame table
+void destroy_shared_memory(shared_memory *mem)
+{
+    if (mem == NULL) {
+        return;
+    }
+    free(mem->owner);
+    free(mem->last_accessed);
+    free(mem->referenced);
+    free(mem->page_table);
+    free(mem);
+}
+
+// Function to create an empty shared frame table for the configuration
+shared_memory *create_shared_memory(const sim_config *config, int deterministic)
+{
+    shared_memory *mem = calloc(1, sizeof(shared_memory));
+    if (mem == NULL) {
+        return NULL;
+    }
+    int pages = config->processes * config->pages_per_process;
+    mem->config = *config;
+    mem->frames = config->ram_size / PAGE_FRAME_SIZE;
+    mem->deterministic = deterministic;
+    mem->owner = malloc(mem->frames * sizeof(*mem->owner));
+    mem->last_accessed = malloc(mem->frames * sizeof(*mem->last_accessed));
+    mem->referenced = malloc(mem->frames * sizeof(*mem->referenced));
+    mem->page_table = malloc(pages * sizeof(*mem->page_table));
+    if (mem->owner == NULL || mem->last_accessed == NULL || mem->referenced == NULL || mem->page_table == NULL) {
+        destroy_shared_memory(mem);
+        return NULL;
+    }
+    for (int f = 0; f < mem->frames; f++) {
+        atomic_init(&mem->owner[f], -1);
+        atomic_init(&mem->last_accessed[f], 0);
+        atomic_init(&mem->referenced[f], 0);
+    }
+    for (int i = 0; i < pages; i++) {
+        atomic_init(&mem->page_table[i], NOT_RESIDENT);
+    }
+    atomic_init(&mem->clock_hand, 0);
+    atomic_init(&mem->next_free, 0);
+    atomic_init(&mem->time, 0);
+    atomic_init(&mem->next_ticket, 0);
+    atomic_init(&mem->start, 0);
+    return mem;
+}
+
+// Second-chance candidate: advance the shared hand past free, busy and referenced frames
+static int shared_clock_candidate(shared_memory *mem, int *owner) {
+    for (;;) {
+        int f = (int)(atomic_fetch_add(&mem->clock_hand, 1) % (unsigned long)mem->frames);
+        int o = atomic_load(&mem->owner[f]);
+        if (o < 0) {
+            continue;
+        }
+        if (atomic_exchange(&mem->referenced[f], 0)) {
+            continue;  // Give the page a second chance
+        }
+        *owner = o;
+        return f;
+    }
+}
+
+// Approximate LRU candidate: the oldest of LRU_SAMPLES randomly chosen frames
+static int shared_lru_candidate(cpu_thread *cpu, int *owner) {
+    shared_memory *mem = cpu->mem;
+    for (;;) {
+        int best = -1;
+        long long best_time = TIME_MAX;
+        for (int s = 0; s < LRU_SAMPLES; s++) {
+            unsigned int x = cpu->random_state;
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            cpu->random_state = x;
+
+            int f = (int)(x % (unsigned int)mem->frames);
+            int o = atomic_load(&mem->owner[f]);
+            long long t = atomic_load(&mem->last_accessed[f]);
+            if (o >= 0 && t < best_time) {
+                best = f;
+                best_time = t;
+                *owner = o;
+            }
+        }
+        if (best != -1) {
+            return best;
+        }
+    }
+}
+
+// Function to claim a frame for a faulting CPU: a never used frame, else a victim locked by CAS.
+// Returns with the frame's owner set to FRAME_BUSY; the caller releases it by publishing the page.
+static int claim_frame(cpu_thread *cpu, cpu_stats *stats) {
+    shared_memory *mem = cpu->mem;
+    if (atomic_load(&mem->next_free) < mem->frames) {
+        int f = atomic_fetch_add(&mem->next_free, 1);
+        if (f < mem->frames) {
+            atomic_store(&mem->owner[f], FRAME_BUSY);
+            return f;
+        }
+    }
+    for (;;) {
+        int victim_page;
+        int f = mem->config.policy == POLICY_CLOCK ? shared_clock_candidate(mem, &victim_page)
+                                                   : shared_lru_candidate(cpu, &victim_page);
+        if (atomic_compare_exchange_strong(&mem->owner[f], &victim_page, FRAME_BUSY)) {
+            atomic_store(&mem->page_table[victim_page], NOT_RESIDENT);  // Evict the page
+            stats->evictions++;
+            return f;
+        }
+        stats->cas_failures++;
+    }
+}
+
+// Handle one request of a CPU against the shared frame table
+static void shared_request(cpu_thread *cpu, const request *req, cpu_stats *stats) {
+    shared_memory *mem = cpu->mem;
+    int page = req->pid * mem->config.pages_per_process + req->page_num;
+    long long now = 0;
+    if (mem->config.policy == POLICY_LRU) {
+        // Stamps only need to order pages roughly for the sampled LRU. Bumping the clock once per
+        // batch instead of once per request keeps its cache line shared rather than bouncing
+        if (++cpu->unstamped == LRU_STAMP_BATCH) {
+            atomic_fetch_add_explicit(&mem->time, LRU_STAMP_BATCH, memory_order_relaxed);
+            cpu->unstamped = 0;
+        }
+        now = atomic_load_explicit(&mem->time, memory_order_relaxed);
+    }
+    stats->requests++;
+
+    // Only this CPU runs the page's process, so only an eviction can move the page under us.
+    // A frame whose owner no longer matches is locked by an evicting CPU: spin until its
+    // page-table store lands.
+    for (;;) {
+        int frame = atomic_load(&mem->page_table[page]);
+        if (frame == NOT_RESIDENT) {
+            break;
+        }
+        if (atomic_load(&mem->owner[frame]) == page) {
+            // An eviction racing these stores at worst leaves a stale bit on the next page
+            atomic_store(&mem->referenced[frame], 1);
+            atomic_store(&mem->last_accessed[frame], now);
+            stats->hits++;
+            return;
+        }
+        sched_yield();  // Let the evicting CPU finish when the threads outnumber the cores
+    }
+
+    // Page fault: fill a frame, then publish it. The page table goes first: once the owner
+    // is set another CPU may evict the page, and its NOT_RESIDENT store must be the last one.
+    stats->faults++;
+    int frame = claim_frame(cpu, stats);
+    atomic_store(&mem->last_accessed[frame], now);
+    atomic_store(&mem->referenced[frame], 1);
+    atomic_store(&mem->page_table[page], frame);
+    atomic_store(&mem->owner[frame], page);  // Unlocks the frame
+}
+
+static void *cpu_thread_main(void *arg) {
+    cpu_thread *cpu = arg;
+    shared_memory *mem = cpu->mem;
+    cpu_stats stats = { 0 };  // Kept local so the CPUs' counters never share a cache line
+
+    int start;
+    while ((start = atomic_load(&mem->start)) == 0) {
+        sched_yield();
+    }
+    for (long i = 0; start == 1 && i < cpu->length; i++) {
+        if (mem->deterministic) {
+            // Take turns in trace order; the interleaving is then the same on every run
+            while (atomic_load(&mem->next_ticket) != cpu->ticket[i]) {
+                sched_yield();
+            }
+        }
+        shared_request(cpu, &cpu->requests[i], &stats);
+        if (mem->deterministic) {
+            atomic_store(&mem->next_ticket, cpu->ticket[i] + 1);
+        }
+    }
+    cpu->stats = stats;
+    return NULL;
+}
+
+// Function to release the per-CPU request streams
+void free_cpu_threads(cpu_thread *cpus, int cpu_count)
+{
+    if (cpus == NULL) {
+        return;
+    }
+    for (int c = 0; c < cpu_count; c++) {
+        free(cpus[c].requests);
+        free(cpus[c].ticket);
+    }
+    free(cpus);
+}
+
+// Function to split the trace into one request stream per CPU, scheduling process p on CPU p % cpus
+cpu_thread *create_cpu_threads(const trace *tr, int cpu_count, int deterministic)
+{
+    cpu_thread *cpus = calloc(cpu_count, sizeof(cpu_thread));
+    if (cpus == NULL) {
+        return NULL;
+    }
+    for (long i = 0; i < tr->length; i++) {
+        cpus[tr->requests[i].pid % cpu_count].length++;
+    }
+    for (int c = 0; c < cpu_count; c++) {
+        cpus[c].id = c;
+        cpus[c].random_state = 2463534242u + c;
+        cpus[c].requests = malloc((cpus[c].length + 1) * sizeof(request));
+        cpus[c].ticket = deterministic ? malloc((cpus[c].length + 1) * sizeof(long)) : NULL;
+        if (cpus[c].requests == NULL || (deterministic && cpus[c].ticket == NULL)) {
+            free_cpu_threads(cpus, cpu_count);
+            return NULL;
+        }
+        cpus[c].length = 0;
+    }
+    for (long i = 0; i < tr->length; i++) {
+        cpu_thread *cpu = &cpus[tr->requests[i].pid % cpu_count];
+        if (deterministic) {
+            cpu->ticket[cpu->length] = i;
+        }
+        cpu->requests[cpu->length++] = tr->requests[i];
+    }
+    return cpus;
+}
+
+// Run the trace on cpu_count CPU threads sharing one frame table; *seconds gets the wall time
+// of the replay alone. Returns -1 when memory or threads run out.
+int run_parallel(const trace *tr, const sim_config *config, int cpu_count, int deterministic,
+                 cpu_stats *stats, double *seconds) {
+    shared_memory *mem = create_shared_memory(config, deterministic);
+    cpu_thread *cpus = create_cpu_threads(tr, cpu_count, deterministic);
+    pthread_t *tids = calloc(cpu_count, sizeof(pthread_t));
+    if (mem == NULL || cpus == NULL || tids == NULL) {
+        destroy_shared_memory(mem);
+        free_cpu_threads(cpus, cpu_count);
+        free(tids);
+        return -1;
+    }
+
+    // Every CPU waits for the start flag, so a failed pthread_create can still call the run off
+    int started = 1;
+    for (int c = 0; c < cpu_count; c++) {
+        cpus[c].mem = mem;
+        if (c > 0) {
+            if (pthread_create(&tids[c], NULL, cpu_thread_main, &cpus[c]) != 0) {
+                break;
+            }
+            started++;
+        }
+    }
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    atomic_store(&mem->start, started == cpu_count ? 1 : -1);
+    cpu_thread_main(&cpus[0]);  // The calling thread is CPU 0
+    for (int c = 1; c < started; c++) {
+        pthread_join(tids[c], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    for (int c = 0; c < cpu_count; c++) {
+        stats[c] = cpus[c].stats;
+    }
+    int status = started == cpu_count ? 0 : -1;
+    destroy_shared_memory(mem);
+    free_cpu_threads(cpus, cpu_count);
+    free(tids);
+    return status;
+}
+
+// Function to add up the counters of every CPU
+static cpu_stats sum_cpu_stats(const cpu_stats *stats, int cpu_count) {
+    cpu_stats total = { 0 };
+    for (int c = 0; c < cpu_count; c++) {
+        total.requests += stats[c].requests;
+        total.hits += stats[c].hits;
+        total.faults += stats[c].faults;
+        total.evictions += stats[c].evictions;
+        total.cas_failures += stats[c].cas_failures;
+    }
+    return total;
+}
+
+static void write_cpu_row(FILE *f, const char *cpu, const cpu_stats *s) {
+    fprintf(f, "%-4s %12ld %12ld %12ld %12ld %12ld %10.6f\n", cpu, s->requests, s->hits, s->faults, s->evictions,
+            s->cas_failures, s->requests ? (double)s->faults / s->requests : 0.0);
+}
+
+// Function to write the counters of every CPU of a parallel run and their total
+void write_parallel_table(const cpu_stats *stats, int cpu_count, FILE *output_file) {
+    fprintf(output_file, "%-4s %12s %12s %12s %12s %12s %10s\n",
+            "cpu", "requests", "hits", "faults", "evictions", "cas_failures", "fault_rate");
+    char cpu[16];
+    for (int c = 0; c < cpu_count; c++) {
+        snprintf(cpu, sizeof(cpu), "%d", c);
+        write_cpu_row(output_file, cpu, &stats[c]);
+    }
+    cpu_stats total = sum_cpu_stats(stats, cpu_count);
+    write_cpu_row(output_file, "all", &total);
+}
+
+// Function to replay the trace on 1..max_cpus CPUs and write throughput and speedup per CPU count.
+// Without --deterministic each CPU count interleaves the processes differently and so faults a
+// different number of times; ns_per_req and fault_rate sit next to the speedup for that reason.
+int write_scaling_table(const trace *tr, const sim_config *config, int max_cpus, int deterministic,
+                        FILE *output_file) {
+    cpu_stats *stats = malloc(max_cpus * sizeof(cpu_stats));
+    if (stats == NULL) {
+        return -1;
+    }
+    fprintf(output_file, "%-4s %12s %14s %10s %12s %12s %10s %8s %12s\n", "cpus", "seconds", "requests_per_s",
+            "ns_per_req", "hits", "faults", "fault_rate", "speedup", "cas_failures");
+    double base = 0.0;
+    for (int n = 1; n <= max_cpus; n++) {
+        double seconds;
+        if (run_parallel(tr, config, n, deterministic, stats, &seconds) != 0) {
+            free(stats);
+            return -1;
+        }
+        if (n == 1) {
+            base = seconds;
+        }
+        cpu_stats total = sum_cpu_stats(stats, n);
+        fprintf(output_file, "%-4d %12.6f %14.0f %10.1f %12ld %12ld %10.6f %8.3f %12ld\n", n, seconds,
+                seconds > 0.0 ? tr->length / seconds : 0.0, tr->length ? seconds * 1e9 / tr->length : 0.0,
+                total.hits, total.faults, tr->length ? (double)total.faults / tr->length : 0.0,
+                seconds > 0.0 ? base / seconds : 0.0, total.cas_failures);
+        fflush(output_file);
+    }
+    free(stats);
+    return 0;
+}
+
+// LRU stack distances of one reference stream (Mattson's algorithm).
+// Every page's latest access is a marker in a Fenwick tree indexed by position, so the number of
+// distinct pages touched since the previous access to a page is a prefix-sum difference.
+// Positions are renumbered once they run out, which keeps the tree at O(distinct pages).
+typedef struct stack_distance
+{
+    int pages;        // distinct pages the stream can name
+    int capacity;     // positions available before the markers are compacted
+    int now;          // position of the next access
+    int *last;        // position of each page's latest access, -1 before its first
+    int *page_at;     // page whose latest access sits at a position, -1 if superseded
+    int *tree;        // Fenwick tree over positions, 1 where a marker sits
+    long *histogram;  // histogram[d]: accesses whose LRU stack distance is d (1..pages)
+    long cold;        // first accesses, which miss at every memory size
+    long accesses;
+} stack_distance;
+
+int init_stack_distance(stack_distance *sd, int pages) {
+    sd->pages = pages;
+    sd->capacity = 2 * pages + 16;
+    sd->now = 0;
+    sd->cold = 0;
+    sd->accesses = 0;
+    sd->last = malloc(pages * sizeof(int));
+    sd->page_at = malloc(sd->capacity * sizeof(int));
+    sd->tree = calloc(sd->capacity, sizeof(int));
+    sd->histogram = calloc(pages + 1, sizeof(long));
+    if (sd->last == NULL || sd->page_at == NULL || sd->tree == NULL || sd->histogram == NULL) {
+        return -1;
+    }
+    for (int p = 0; p < pages; p++) {
+        sd->last[p] = -1;
+    }
+    for (int i = 0; i < sd->capacity; i++) {
+        sd->page_at[i] = -1;
+    }
+    return 0;
+}
+
+void free_stack_distance(stack_distance *sd) {
+    free(sd->last);
+    free(sd->page_at);
+    free(sd->tree);
+    free(sd->histogram);
+}
+
+static void fenwick_add(int *tree, int size, int i, int delta) {
+    for (; i < size; i |= i + 1) {
+        tree[i] += delta;
+    }
+}
+
+// Sum of tree positions 0..i
+static int fenwick_prefix(const int *tree, int i) {
+    int sum = 0;
+    for (; i >= 0; i = (i & (i + 1)) - 1) {
+        sum += tree[i];
+    }
+    return sum;
+}
+
+// Slide the live markers down to positions 0..k-1 and rebuild the tree in linear time
+static void compact_stack_distance(stack_distance *sd) {
+    int next = 0;
+    for (int pos = 0; pos < sd->now; pos++) {
+        int p = sd->page_at[pos];
+        if (p != -1) {
+            sd->page_at[next] = p;
+            sd->last[p] = next;
+            next++;
+        }
+    }
+    for (int pos = next; pos < sd->capacity; pos++) {
+        sd->page_at[pos] = -1;
+    }
+    for (int i = 0; i < sd->capacity; i++) {
+        sd->tree[i] = i < next;
+    }
+    for (int i = 0; i < sd->capacity; i++) {
+        int parent = i | (i + 1);
+        if (parent < sd->capacity) {
+            sd->tree[parent] += sd->tree[i];
+        }
+    }
+    sd->now = next;
+}
+
+// Record an access to a page and the stack distance it was found at
+void stack_distance_access(stack_distance *sd, int page) {
+    if (sd->now == sd->capacity) {
+        compact_stack_distance(sd);
+    }
+    int prev = sd->last[page];
+    if (prev == -1) {
+        sd->cold++;
+    } else {
+        int distance = fenwick_prefix(sd->tree, sd->now - 1) - fenwick_prefix(sd->tree, prev) + 1;
+        sd->histogram[distance]++;
+        fenwick_add(sd->tree, sd->capacity, prev, -1);
+        sd->page_at[prev] = -1;
+    }
+    fenwick_add(sd->tree, sd->capacity, sd->now, 1);
+    sd->page_at[sd->now] = page;
+    sd->last[page] = sd->now;
+    sd->now++;
+    sd->accesses++;
+}
+
+// Misses of an LRU memory of every size 0..pages frames, from the distance histogram
+void stack_distance_misses(const stack_distance *sd, long *misses) {
+    long beyond = 0;  // accesses at distance greater than the size being filled in
+    for (int frames = sd->pages; frames >= 0; frames--) {
+        misses[frames] = sd->cold + beyond;
+        beyond += sd->histogram[frames];
+    }
+}
+
+// Global and per-process miss-ratio curves built from one pass over the requests
+typedef struct mrc_tracker
+{
+    sim_config config;
+    stack_distance global;     // one LRU RAM shared by every process
+    stack_distance *process;   // each process alone in its own LRU RAM
+} mrc_tracker;
+
+void free_mrc(mrc_tracker *mrc) {
+    if (mrc == NULL) {
+        return;
+    }
+    free_stack_distance(&mrc->global);
+    for (int i = 0; mrc->process && i < mrc->config.processes; i++) {
+        free_stack_distance(&mrc->process[i]);
+    }
+    free(mrc->process);
+    free(mrc);
+}
+
+mrc_tracker *create_mrc(const sim_config *config) {
+    mrc_tracker *mrc = calloc(1, sizeof(mrc_tracker));
+    if (mrc == NULL) {
+        return NULL;
+    }
+    mrc->config = *config;
+    mrc->process = calloc(config->processes, sizeof(stack_distance));
+    int failed = mrc->process == NULL ||
+                 init_stack_distance(&mrc->global, config->processes * config->pages_per_process) != 0;
+    for (int i = 0; !failed && i < config->processes; i++) {
+        failed = init_stack_distance(&mrc->process[i], config->pages_per_process) != 0;
+    }
+    if (failed) {
+        free_mrc(mrc);
+        return NULL;
+    }
+    return mrc;
+}
+
+// Record one request in the global and per-process stacks
+void mrc_request(mrc_tracker *mrc, const request *req) {
+    stack_distance_access(&mrc->global, req->pid * mrc->config.pages_per_process + req->page_num);
+    stack_distance_access(&mrc->process[req->pid], req->page_num);
+}
+
+// Function to write the miss ratio for every RAM size up to the point where only compulsory misses remain
+int write_mrc(const mrc_tracker *mrc, FILE *output_file) {
+    int processes = mrc->config.processes;
+    int max_frames = mrc->global.pages;
+    long *global_misses = malloc((max_frames + 1) * sizeof(long));
+    long *process_misses = malloc((size_t)processes * (mrc->config.pages_per_process + 1) * sizeof(long));
+    if (global_misses == NULL || process_misses == NULL) {
+        free(global_misses);
+        free(process_misses);
+        return -1;
+    }
+    stack_distance_misses(&mrc->global, global_misses);
+    for (int i = 0; i < processes; i++) {
+        stack_distance_misses(&mrc->process[i], &process_misses[i * (mrc->config.pages_per_process + 1)]);
+    }
+
+    fprintf(output_file, "frames,ram_size,misses,miss_ratio");
+    for (int i = 0; i < processes; i++) {
+        fprintf(output_file, ",p%d", i);
+    }
+    fprintf(output_file, "\n");
+    for (int frames = 1; frames <= max_frames; frames++) {
+        long requests = mrc->global.accesses;
+        fprintf(output_file, "%d,%d,%ld,%.6f", frames, frames * PAGE_FRAME_SIZE, global_misses[frames],
+                requests ? (double)global_misses[frames] / requests : 0.0);
+        for (int i = 0; i < processes; i++) {
+            const stack_distance *sd = &mrc->process[i];
+            int own = frames < sd->pages ? frames : sd->pages;  // a process cannot use more frames than pages
+            long misses = process_misses[i * (mrc->config.pages_per_process + 1) + own];
+            fprintf(output_file, ",%.6f", sd->accesses ? (double)misses / sd->accesses : 0.0);
+        }
+        fprintf(output_file, "\n");
+    }
+    free(global_misses);
+    free(process_misses);
+    return 0;
+}
+
+// Function to parse a comma separated list of integers no smaller than minimum
+int parse_int_list(const char *arg, int minimum, int *values, int max_values) {
+    int count = 0;
+    const char *p = arg;
+    while (*p) {
+        char *end;
+        long value = strtol(p, &end, 10);
+        if (end == p || value < minimum || value > INT_MAX || count == max_values || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        values[count++] = (int)value;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+// Function to parse a fraction between 0 and 1; returns 1 on success
+int parse_fraction(const char *arg, double *value) {
+    char *end;
+    *value = strtod(arg, &end);
+    return end != arg && *end == '\0' && *value >= 0.0 && *value <= 1.0;
+}
+
+// Function to parse a comma separated list of names into their indexes
+int parse_name_list(const char *arg, const char **names, int name_count, int *values, int max_values) {
+    int count = 0;
+    const char *p = arg;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        int found = -1;
+        for (int n = 0; n < name_count; n++) {
+            if (strlen(names[n]) == len && strncmp(p, names[n], len) == 0) {
+                found = n;
+            }
+        }
+        if (found == -1 || count == max_values) {
+            return -1;
+        }
+        values[count++] = found;
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return count;
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [options] <input_file|-> <output_file>\n", program);
+    fprintf(stderr, "  --ram N[,N...]          RAM size in slots (default %d)\n", RAM_SIZE);
+    fprintf(stderr, "  --policy P[,P...]       replacement policy: lru, fifo, clock (default lru)\n");
+    fprintf(stderr, "  --alloc A[,A...]        frame allocation: local, global, equal, proportional, wset, pff\n");
+    fprintf(stderr, "                          (default local)\n");
+    fprintf(stderr, "  --wset-window N         working-set window tau in time steps (default %d)\n", WSET_WINDOW);
+    fprintf(stderr, "  --pff-window N          references per fault-rate measurement (default %d)\n", PFF_WINDOW);
+    fprintf(stderr, "  --pff-low F             fault rate that takes a frame away (default %g)\n", PFF_LOW);
+    fprintf(stderr, "  --pff-high F            fault rate that grants a frame (default %g)\n", PFF_HIGH);
+    fprintf(stderr, "  --no-load-control       never suspend processes under wset or pff\n");
+    fprintf(stderr, "  --processes N           number of processes (default %d)\n", PROCESSES);
+    fprintf(stderr, "  --pages N               pages per process (default %d)\n", PAGES_PER_PROCESS);
+    fprintf(stderr, "  --trace-format F        pids (default): process ids only, the page follows the time step\n");
+    fprintf(stderr, "                          records: one \"pid page [r|w]\" per line\n");
+    fprintf(stderr, "  --tlb-entries N[,N...]  TLB entries, 0 for no TLB (default 0)\n");
+    fprintf(stderr, "  --tlb-ways N            TLB associativity (default: fully associative)\n");
+    fprintf(stderr, "  --tlb-policy P          TLB replacement: lru, fifo, random (default lru)\n");
+    fprintf(stderr, "  --tlb-switch S          on a process switch: flush the TLB, or keep it with asid tags\n");
+    fprintf(stderr, "  --prefetch P[,P...]     read ahead on a fault: none (default), next (the following pages),\n");
+    fprintf(stderr, "                          stride (a repeated distance), adaptive (stride with a window that\n");
+    fprintf(stderr, "                          grows on used prefetches and shrinks on wasted ones)\n");
+    fprintf(stderr, "  --prefetch-depth N[,N...]\n");
+    fprintf(stderr, "                          pages read ahead, the largest adaptive window (default %d)\n", PREFETCH_DEPTH);
+    fprintf(stderr, "  --shared N              pages 0..N-1 of every process map one shared segment (default 0)\n");
+    fprintf(stderr, "  --cow                   the segment is copy-on-write, as after a fork: a write record gives\n");
+    fprintf(stderr, "                          the writer its own copy\n");
+    fprintf(stderr, "  --page-table T[,T...]   organization whose walks and size are counted: flat (default),\n");
+    fprintf(stderr, "                          radix2, radix3, radix4 (levels over a 48-bit address space),\n");
+    fprintf(stderr, "                          hashed, inverted\n");
+    fprintf(stderr, "  --huge-pages N[,N...]   pages 0..N-1 of every process are backed by huge pages (default 0)\n");
+    fprintf(stderr, "  --huge-page-size N      base pages per huge page, a power of two (default %d); a radix\n",
+            HUGE_PAGE_SIZE);
+    fprintf(stderr, "                          table needs the span of one of its entries: 2^18 for radix2,\n");
+    fprintf(stderr, "                          2^12 or 2^24 for radix3, 2^9, 2^18 or 2^27 for radix4\n");
+    fprintf(stderr, "  --sweep                 run every ram/policy/alloc/tlb/page-table/huge/prefetch combination,\n");
+    fprintf(stderr, "                          write one table\n");
+    fprintf(stderr, "  --threads N             sweep worker threads (default: online cores)\n");
+    fprintf(stderr, "  --cpus N                replay on N CPU threads sharing one frame table, process p on\n");
+    fprintf(stderr, "                          CPU p %% N; global lru (sampled) or clock, no TLB; frames are\n");
+    fprintf(stderr, "                          claimed under per-frame spinlocks, so CPUs can block each other\n");
+    fprintf(stderr, "  --deterministic         with --cpus, run the requests in trace order for repeatable results\n");
+    fprintf(stderr, "  --scaling               with --cpus N, time the replay on 1..N CPUs; unless --deterministic\n");
+    fprintf(stderr, "                          the fault counts differ per row, so compare ns_per_req and faults\n");
+    fprintf(stderr, "  --mrc                   write global and per-process LRU miss-ratio curves in one pass\n");
+    fprintf(stderr, "  --checkpoint FILE       save a snapshot of the simulation to FILE as it runs\n");
+    fprintf(stderr, "  --checkpoint-every N    requests between snapshots (default %d)\n", CHECKPOINT_INTERVAL);
+    fprintf(stderr, "  --resume FILE           continue from a snapshot; give the same options as the original run\n");
+    fprintf(stderr, "  --stream FILE           record the run as it goes; - for the standard output\n");
+    fprintf(stderr, "  --stream-kind K         deltas (default): one load, evict or hit record per event\n");
+    fprintf(stderr, "                          snapshots: the page tables and RAM every --stream-every steps\n");
+    fprintf(stderr, "  --stream-format F       text (default) or binary\n");
+    fprintf(stderr, "  --stream-every N        requests between snapshots (default %d)\n", STREAM_INTERVAL);
+    fprintf(stderr, "  --stats FILE            write hit, fault and eviction counters per process\n");
+    fprintf(stderr, "  --stats-format F        csv (default) or json\n");
+    fprintf(stderr, "  --sample N              also sample the counters every N steps\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int ram_sizes[MAX_SWEEP_VALUES] = { RAM_SIZE };
+    int policies[MAX_SWEEP_VALUES] = { POLICY_LRU };
+    int allocs[MAX_SWEEP_VALUES] = { ALLOC_LOCAL };
+    int tlb_sizes[MAX_SWEEP_VALUES] = { 0 };
+    int prefetches[MAX_SWEEP_VALUES] = { PREFETCH_NONE };
+    int prefetch_depths[MAX_SWEEP_VALUES] = { PREFETCH_DEPTH };
+    int page_tables[MAX_SWEEP_VALUES] = { PT_FLAT };
+    int huge_pages[MAX_SWEEP_VALUES] = { 0 };
+    int ram_count = 1, policy_count = 1, alloc_count = 1, tlb_count = 1, prefetch_count = 1, depth_count = 1;
+    int page_table_count = 1, huge_count = 1;
+    int huge_page_size = HUGE_PAGE_SIZE;
+    int tlb_ways = 0;
+    int tlb_policy_index = TLB_LRU;
+    int tlb_switch_index = TLB_FLUSH;
+    int wset_window = WSET_WINDOW;
+    int pff_window = PFF_WINDOW;
+    double pff_low = PFF_LOW;
+    double pff_high = PFF_HIGH;
+    int load_control = 1;
+    int shared_pages = 0;
+    int cow = 0;
+    int cpus = 0;
+    int deterministic = 0;
+    int scaling = 0;
+    const char *checkpoint_path = NULL;
+    int checkpoint_interval = CHECKPOINT_INTERVAL;
+    const char *resume_path = NULL;
+    const char *stream_path = NULL;
+    int stream_kind_index = STREAM_DELTAS;
+    int stream_format_index = STREAM_TEXT;
+    int stream_interval = STREAM_INTERVAL;
+    int processes = PROCESSES;
+    int pages_per_process = PAGES_PER_PROCESS;
+    int sweep = 0;
+    int mrc_mode = 0;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *stats_path = NULL;
+    int stats_format_index = STATS_CSV;
+    int sample_interval = 0;
+    int trace_format_index = TRACE_PIDS;
+    const char *files[2];
+    int file_count = 0;
+
+    // Parse options; the two file names stay positional
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = 1;
+
+        if (strcmp(arg, "--sweep") == 0) {
+            sweep = 1;
+            continue;
+        }
+        if (strcmp(arg, "--mrc") == 0) {
+            mrc_mode = 1;
+            continue;
+        }
+        if (strcmp(arg, "--no-load-control") == 0) {
+            load_control = 0;
+            continue;
+        }
+        if (strcmp(arg, "--cow") == 0) {
+            cow = 1;
+            continue;
+        }
+        if (strcmp(arg, "--deterministic") == 0) {
+            deterministic = 1;
+            continue;
+        }
+        if (strcmp(arg, "--scaling") == 0) {
+            scaling = 1;
+            continue;
+        }
+        if (arg[0] != '-' || arg[1] == '\0') {
+            if (file_count == 2) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            files[file_count++] = arg;
+            continue;
+        }
+        if (value == NULL) {
+            ok = 0;
+        } else if (strcmp(arg, "--ram") == 0) {
+            ram_count = parse_int_list(value, 1, ram_sizes, MAX_SWEEP_VALUES);
+            for (int r = 0; r < ram_count; r++) {
+                ok = ok && ram_sizes[r] % PAGE_FRAME_SIZE == 0;  // Whole frames only
+            }
+            ok = ok && ram_count > 0;
+        } else if (strcmp(arg, "--policy") == 0) {
+            policy_count = parse_name_list(value, policy_names, POLICY_COUNT, policies, MAX_SWEEP_VALUES);
+            ok = policy_count > 0;
+        } else if (strcmp(arg, "--alloc") == 0) {
+            alloc_count = parse_name_list(value, alloc_names, ALLOC_COUNT, allocs, MAX_SWEEP_VALUES);
+            ok = alloc_count > 0;
+        } else if (strcmp(arg, "--wset-window") == 0) {
+            ok = parse_int_list(value, 1, &wset_window, 1) == 1;
+        } else if (strcmp(arg, "--pff-window") == 0) {
+            ok = parse_int_list(value, 1, &pff_window, 1) == 1;
+        } else if (strcmp(arg, "--pff-low") == 0) {
+            ok = parse_fraction(value, &pff_low);
+        } else if (strcmp(arg, "--pff-high") == 0) {
+            ok = parse_fraction(value, &pff_high);
+        } else if (strcmp(arg, "--tlb-entries") == 0) {
+            tlb_count = parse_int_list(value, 0, tlb_sizes, MAX_SWEEP_VALUES);
+            ok = tlb_count > 0;
+        } else if (strcmp(arg, "--tlb-ways") == 0) {
+            ok = parse_int_list(value, 1, &tlb_ways, 1) == 1;
+        } else if (strcmp(arg, "--tlb-policy") == 0) {
+            ok = parse_name_list(value, tlb_policy_names, TLB_POLICY_COUNT, &tlb_policy_index, 1) == 1;
+        } else if (strcmp(arg, "--tlb-switch") == 0) {
+            ok = parse_name_list(value, tlb_switch_names, TLB_SWITCH_COUNT, &tlb_switch_index, 1) == 1;
+        } else if (strcmp(arg, "--prefetch") == 0) {
+            prefetch_count = parse_name_list(value, prefetch_names, PREFETCH_COUNT, prefetches, MAX_SWEEP_VALUES);
+            ok = prefetch_count > 0;
+        } else if (strcmp(arg, "--prefetch-depth") == 0) {
+            depth_count = parse_int_list(value, 1, prefetch_depths, MAX_SWEEP_VALUES);
+            ok = depth_count > 0;
+        } else if (strcmp(arg, "--page-table") == 0) {
+            page_table_count = parse_name_list(value, page_table_names, PT_KIND_COUNT, page_tables, MAX_SWEEP_VALUES);
+            ok = page_table_count > 0;
+        } else if (strcmp(arg, "--huge-pages") == 0) {
+            huge_count = parse_int_list(value, 0, huge_pages, MAX_SWEEP_VALUES);
+            ok = huge_count > 0;
+        } else if (strcmp(arg, "--huge-page-size") == 0) {
+            ok = parse_int_list(value, 2, &huge_page_size, 1) == 1 && (huge_page_size & (huge_page_size - 1)) == 0;
+        } else if (strcmp(arg, "--shared") == 0) {
+            ok = parse_int_list(value, 0, &shared_pages, 1) == 1;
+        } else if (strcmp(arg, "--processes") == 0) {
+            ok = parse_int_list(value, 1, &processes, 1) == 1;
+        } else if (strcmp(arg, "--pages") == 0) {
+            ok = parse_int_list(value, 1, &pages_per_process, 1) == 1;
+        } else if (strcmp(arg, "--cpus") == 0) {
+            ok = parse_int_list(value, 1, &cpus, 1) == 1;
+        } else if (strcmp(arg, "--threads") == 0) {
+            ok = parse_int_list(value, 1, &threads, 1) == 1;
+        } else if (strcmp(arg, "--checkpoint") == 0) {
+            checkpoint_path = value;
+        } else if (strcmp(arg, "--checkpoint-every") == 0) {
+            ok = parse_int_list(value, 1, &checkpoint_interval, 1) == 1;
+        } else if (strcmp(arg, "--resume") == 0) {
+            resume_path = value;
+        } else if (strcmp(arg, "--stream") == 0) {
+            stream_path = value;
+        } else if (strcmp(arg, "--stream-kind") == 0) {
+            ok = parse_name_list(value, stream_kind_names, STREAM_KIND_COUNT, &stream_kind_index, 1) == 1;
+        } else if (strcmp(arg, "--stream-format") == 0) {
+            ok = parse_name_list(value, stream_format_names, STREAM_FORMAT_COUNT, &stream_format_index, 1) == 1;
+        } else if (strcmp(arg, "--stream-every") == 0) {
+            ok = parse_int_list(value, 1, &stream_interval, 1) == 1;
+        } else if (strcmp(arg, "--stats") == 0) {
+            stats_path = value;
+        } else if (strcmp(arg, "--stats-format") == 0) {
+            ok = parse_name_list(value, stats_format_names, STATS_FORMAT_COUNT, &stats_format_index, 1) == 1;
+        } else if (strcmp(arg, "--trace-format") == 0) {
+            ok = parse_name_list(value, trace_format_names, TRACE_FORMAT_COUNT, &trace_format_index, 1) == 1;
+        } else if (strcmp(arg, "--sample") == 0) {
+            ok = parse_int_list(value, 1, &sample_interval, 1) == 1;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid option %s %s\n", arg, value ? value : "");
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;  // Skip the option's value
+    }
+
+    if (file_count < 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!sweep && (ram_count > 1 || policy_count > 1 || alloc_count > 1 || tlb_count > 1 || prefetch_count > 1 ||
+                   depth_count > 1 || page_table_count > 1 || huge_count > 1)) {
+        fprintf(stderr, "Lists of values need --sweep\n");
+        return EXIT_FAILURE;
+    }
+    for (int t = 0; t < tlb_count; t++) {
+        if (tlb_ways && tlb_sizes[t] % tlb_ways != 0) {
+            fprintf(stderr, "--tlb-entries %d is not a multiple of --tlb-ways %d\n", tlb_sizes[t], tlb_ways);
+            return EXIT_FAILURE;
+        }
+    }
+    if (pff_low > pff_high) {
+        fprintf(stderr, "--pff-low cannot be above --pff-high\n");
+        return EXIT_FAILURE;
+    }
+    if (shared_pages > pages_per_process) {
+        fprintf(stderr, "--shared cannot exceed --pages\n");
+        return EXIT_FAILURE;
+    }
+    int any_huge_pages = 0;
+    int inverted = 0;
+    for (int h = 0; h < huge_count; h++) {
+        if (huge_pages[h] > pages_per_process || huge_pages[h] % huge_page_size != 0) {
+            fprintf(stderr, "--huge-pages %d is not a multiple of --huge-page-size %d within --pages\n", huge_pages[h],
+                    huge_page_size);
+            return EXIT_FAILURE;
+        }
+        any_huge_pages |= huge_pages[h] > 0;
+    }
+    for (int g = 0; g < page_table_count; g++) {
+        inverted |= page_tables[g] == PT_INVERTED;
+        sim_config radix = { .page_table_kind = page_tables[g], .huge_page_size = huge_page_size };
+        if (any_huge_pages && page_tables[g] >= PT_RADIX2 && page_tables[g] <= PT_RADIX4 &&
+            huge_page_levels(&radix) == 0) {
+            fprintf(stderr, "--huge-page-size %d is not the span of a %s page-table entry\n", huge_page_size,
+                    page_table_names[page_tables[g]]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (shared_pages && (any_huge_pages || inverted)) {
+        fprintf(stderr, "--shared cannot be combined with huge pages or an inverted page table, which has one\n"
+                        "mapping per frame\n");
+        return EXIT_FAILURE;
+    }
+    if (cow && (shared_pages == 0 || trace_format_index != TRACE_RECORDS)) {
+        fprintf(stderr, "--cow needs --shared and write records (--trace-format records)\n");
+        return EXIT_FAILURE;
+    }
+    if (sweep && stats_path) {
+        fprintf(stderr, "--stats is not available with --sweep, the sweep table has the totals\n");
+        return EXIT_FAILURE;
+    }
+    if (mrc_mode && (sweep || stats_path || shared_pages || page_tables[0] != PT_FLAT || any_huge_pages)) {
+        fprintf(stderr, "--mrc replaces the simulation, it cannot be combined with --sweep, --stats, --shared,\n"
+                        "--page-table or --huge-pages\n");
+        return EXIT_FAILURE;
+    }
+
+    if (stream_path && (sweep || mrc_mode || cpus)) {
+        fprintf(stderr, "--stream follows a single simulation, not --sweep, --mrc or --cpus\n");
+        return EXIT_FAILURE;
+    }
+    if ((checkpoint_path || resume_path) && (sweep || mrc_mode || cpus)) {
+        fprintf(stderr, "--checkpoint and --resume apply to a single simulation, not --sweep, --mrc or --cpus\n");
+        return EXIT_FAILURE;
+    }
+    if ((deterministic || scaling) && !cpus) {
+        fprintf(stderr, "--deterministic and --scaling need --cpus\n");
+        return EXIT_FAILURE;
+    }
+    if (cpus && (sweep || mrc_mode || stats_path || tlb_sizes[0] > 0 || policies[0] == POLICY_FIFO ||
+                 allocs[0] > ALLOC_GLOBAL || prefetches[0] != PREFETCH_NONE || shared_pages ||
+                 page_tables[0] != PT_FLAT || any_huge_pages)) {
+        fprintf(stderr, "--cpus replaces globally with lru or clock; it cannot be combined with fifo, frame budgets,\n"
+                        "a TLB, prefetching, shared pages, a page-table organization, huge pages, --sweep, --mrc\n"
+                        "or --stats\n");
+        return EXIT_FAILURE;
+    }
+
+    sim_config config = { ram_sizes[0], processes, pages_per_process, policies[0], allocs[0],
+                          tlb_sizes[0], tlb_ways, tlb_policy_index, tlb_switch_index,
+                          wset_window, pff_window, pff_low, pff_high, load_control,
+                          prefetches[0], prefetch_depths[0], shared_pages, cow,
+                          page_tables[0], huge_pages[0], huge_page_size };
+
+    if (sweep) {
+        trace tr;
+        if (load_trace(files[0], &config, trace_format_index, &tr) != 0) {
+            return EXIT_FAILURE;
+        }
+
+        // One job per (RAM size, policy, allocation mode, TLB size, page table, huge pages, prefetcher,
+        // depth) tuple, the last varying fastest; without prefetching the depth does not matter, so it
+        // gets a single job
+        long combinations = (long)ram_count * policy_count * alloc_count * tlb_count * page_table_count *
+                            huge_count * prefetch_count * depth_count;
+        sweep_job *jobs = combinations <= INT_MAX ? calloc(combinations, sizeof(sweep_job)) : NULL;
+        if (jobs == NULL) {
+            free(tr.requests);
+            fprintf(stderr, "Out of memory\n");
+            return EXIT_FAILURE;
+        }
+        int job_count = 0;
+        for (long k = 0; k < combinations; k++) {
+            long rest = k;
+            int d = rest % depth_count;
+            rest /= depth_count;
+            int f = rest % prefetch_count;
+            rest /= prefetch_count;
+            int h = rest % huge_count;
+            rest /= huge_count;
+            int g = rest % page_table_count;
+            rest /= page_table_count;
+            int t = rest % tlb_count;
+            rest /= tlb_count;
+            int a = rest % alloc_count;
+            rest /= alloc_count;
+            int p = rest % policy_count;
+            int r = (int)(rest / policy_count);
+            if (prefetches[f] == PREFETCH_NONE && d > 0) {
+                continue;
+            }
+            sweep_job *job = &jobs[job_count++];
+            job->config = config;
+            job->config.ram_size = ram_sizes[r];
+            job->config.policy = policies[p];
+            job->config.alloc = allocs[a];
+            job->config.tlb_entries = tlb_sizes[t];
+            job->config.page_table_kind = page_tables[g];
+            job->config.huge_pages = huge_pages[h];
+            job->config.prefetch = prefetches[f];
+            job->config.prefetch_depth = prefetch_depths[d];
+        }
+
+        if (run_sweep(&tr, jobs, job_count, threads) != 0) {
+            free(jobs);
+            free(tr.requests);
+            fprintf(stderr, "Could not start the sweep threads\n");
+            return EXIT_FAILURE;
+        }
+
+        FILE *output_file = fopen(files[1], "w");
+        if (output_file == NULL) {
+            perror("Error opening output file");
+            free(jobs);
+            free(tr.requests);
+            return EXIT_FAILURE;
+        }
+        write_sweep_table(&tr, jobs, job_count, output_file);
+        fclose(output_file);
+        free(jobs);
+        free(tr.requests);
+        return 0;
+    }
+
+    if (cpus) {
+        trace tr;
+        if (load_trace(files[0], &config, trace_format_index, &tr) != 0) {
+            return EXIT_FAILURE;
+        }
+        FILE *output_file = fopen(files[1], "w");
+        if (output_file == NULL) {
+            perror("Error opening output file");
+            free(tr.requests);
+            return EXIT_FAILURE;
+        }
+
+        int status;
+        if (scaling) {
+            status = write_scaling_table(&tr, &config, cpus, deterministic, output_file);
+        } else {
+            cpu_stats *stats = malloc(cpus * sizeof(cpu_stats));
+            double seconds;
+            status = stats ? run_parallel(&tr, &config, cpus, deterministic, stats, &seconds) : -1;
+            if (status == 0) {
+                write_parallel_table(stats, cpus, output_file);
+            }
+            free(stats);
+        }
+        fclose(output_file);
+        free(tr.requests);
+        if (status != 0) {
+            fprintf(stderr, "Out of memory or threads\n");
+            return EXIT_FAILURE;
+        }
+        return 0;
+    }
+
+    // Open input file for reading process requests
+    trace_reader *input = open_trace(files[0], &config, trace_format_index);
+    if (input == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    simulator *sim = NULL;
+    mrc_tracker *mrc = NULL;
+    if (mrc_mode) {
+        mrc = create_mrc(&config);
+    } else if (resume_path) {
+        sim = load_snapshot(resume_path, &config, input);  // Pick up where the snapshot left off
+        if (sim == NULL) {
+            close_trace(input);
+            return EXIT_FAILURE;
+        }
+    } else {
+        sim = initialize_VM(&config);  // Initialize virtual memory and page tables
+    }
+    if (sim == NULL && mrc == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        close_trace(input);
+        return EXIT_FAILURE;
+    }
+
+    if (stats_path) {
+        FILE *stats_file = fopen(stats_path, "w");
+        if (stats_file == NULL) {
+            perror("Error opening statistics file");
+            close_trace(input);
+            destroy_VM(sim);
+            return EXIT_FAILURE;
+        }
+        open_stats(sim, stats_file, stats_format_index, sample_interval);
+    }
+    if (stream_path) {
+        FILE *stream_file = strcmp(stream_path, "-") == 0 ? stdout : fopen(stream_path, "wb");
+        if (stream_file == NULL || open_stream(sim, stream_file, stream_kind_index, stream_format_index,
+                                               stream_interval) != 0) {
+            perror("Error opening stream file");
+            if (stream_file && stream_file != stdout) {
+                fclose(stream_file);
+            }
+            close_trace(input);
+            close_stats(sim);
+            destroy_VM(sim);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Read process requests from the input file
+    request req;
+    int status;
+    while ((status = read_request(input, &req)) == 1) {
+        if (mrc) {
+            mrc_request(mrc, &req);  // Only record the stack distance
+        } else if (submit_request(sim, &req) != 0) {  // Handle memory access for the process
+            fprintf(stderr, "Out of memory\n");
+            status = -1;
+            break;
+        }
+        if (checkpoint_path && input->count % checkpoint_interval == 0 &&
+            save_snapshot(sim, input, checkpoint_path) != 0) {
+            status = -1;
+            break;
+        }
+    }
+    close_trace(input);
+    if (sim && status == 0) {
+        finish_requests(sim);
+    }
+    close_stats(sim);
+    if (close_stream(sim) != 0) {
+        perror("Error writing stream file");
+        status = -1;
+    }
+    if (status != 0) {
+        destroy_VM(sim);
+        free_mrc(mrc);
+        return EXIT_FAILURE;
+    }
+
+    // Open output file for writing results
+    FILE *output_file = fopen(files[1], "w");
+    if (output_file == NULL) {
+        perror("Error opening output file");
+        destroy_VM(sim);
+        free_mrc(mrc);
+        return EXIT_FAILURE;
+    }
+    if (mrc) {
+        status = write_mrc(mrc, output_file);
+        if (status != 0) {
+            fprintf(stderr, "Out of memory\n");
+        }
+    } else if (write_state(sim, output_file) != 0) {
+        perror("Error writing output file");
+        status = -1;
+    }
+    fclose(output_file);
+
+    destroy_VM(sim);
+    free_mrc(mrc);
+    return status != 0 ? EXIT_FAILURE : 0;
 }
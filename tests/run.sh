@@ -0,0 +1,66 @@
+#!/bin/sh
+# Golden tests: run the simulator on every case's in.txt with the options in its args file and
+# compare the output file, and the --stats file when the case has a stats.csv, byte for byte.
+# Usage: tests/run.sh [simulator], from the repository root, after
+#   gcc -std=c11 -O2 -Wall -Wextra -pthread -o sim simulation.c
+# A case with a resume file is also run from a mid-trace checkpoint, which must give the same
+# files. A case with an mrc file checks the curve against global LRU runs at those RAM sizes.
+
+sim=${1:-./sim}
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+fail() {
+    echo "FAIL $1: $2"
+    failed=1
+}
+
+# The original assignment's fixed configuration
+"$sim" in.txt "$tmp/out.txt" && cmp -s "$tmp/out.txt" out.txt || fail in.txt "output differs"
+
+for dir in tests/*/; do
+    name=$(basename "$dir")
+    args=$(cat "$dir/args")
+    stats=""
+    if [ -f "$dir/stats.csv" ]; then
+        stats="--stats $tmp/stats.csv"
+    fi
+    # shellcheck disable=SC2086  # args and stats are option lists
+    if ! "$sim" $args $stats "$dir/in.txt" "$tmp/out.txt"; then
+        fail "$name" "exited with an error"
+        continue
+    fi
+    cmp -s "$tmp/out.txt" "$dir/out.txt" || fail "$name" "output differs"
+    if [ -n "$stats" ]; then
+        cmp -s "$tmp/stats.csv" "$dir/stats.csv" || fail "$name" "stats differ"
+    fi
+
+    if [ -f "$dir/resume" ]; then
+        every=$(cat "$dir/resume")
+        # shellcheck disable=SC2086
+        "$sim" $args --checkpoint "$tmp/snapshot" --checkpoint-every "$every" "$dir/in.txt" "$tmp/partial.txt" &&
+            "$sim" $args $stats --resume "$tmp/snapshot" "$dir/in.txt" "$tmp/out.txt" || fail "$name" "resume failed"
+        cmp -s "$tmp/out.txt" "$dir/out.txt" || fail "$name" "resumed output differs"
+        if [ -n "$stats" ]; then
+            cmp -s "$tmp/stats.csv" "$dir/stats.csv" || fail "$name" "resumed stats differ"
+        fi
+    fi
+
+    if [ -f "$dir/mrc" ]; then
+        lru_args=$(cat "$dir/mrc")
+        for ram in $(awk -F, 'NR > 1 { print $2 }' "$dir/out.txt"); do
+            # shellcheck disable=SC2086
+            "$sim" $lru_args --ram "$ram" --policy lru --alloc global --stats "$tmp/lru.csv" "$dir/in.txt" \
+                "$tmp/lru.txt" || fail "$name" "global LRU run at --ram $ram failed"
+            faults=$(awk -F, '$3 == "all" { print $5 }' "$tmp/lru.csv")
+            misses=$(awk -F, -v ram="$ram" '$2 == ram { print $3 }' "$dir/out.txt")
+            [ "$faults" = "$misses" ] || fail "$name" "--ram $ram: $misses misses, global LRU has $faults faults"
+        done
+    fi
+done
+
+if [ $failed -eq 0 ]; then
+    echo "all golden tests passed"
+fi
+exit $failed
@@ -0,0 +1,268 @@
+// Build: gcc -std=c11 -O2 -o tracegen tracegen.c -lm
+//
+// Writes reproducible "pid page r|w" traces for simulation --trace-format records.
+// The same pattern, options and seed always produce the same trace.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#define PROCESSES 4
+#define PAGES_PER_PROCESS 4
+#define WRITE_BUFFER_SIZE (1 << 20)
+
+typedef enum { SEQUENTIAL, LOOP, UNIFORM, ZIPF, PHASE, PATTERN_COUNT } pattern;
+
+static const char *pattern_names[PATTERN_COUNT] = { "sequential", "loop", "uniform", "zipf", "phase" };
+
+typedef struct generator
+{
+    pattern kind;
+    int processes;
+    int pages;
+    uint64_t state;       // xorshift64* state, never zero
+    double write_ratio;   // fraction of requests that are writes
+    int loop_length;      // pages in each process's loop (loop)
+    int working_set;      // pages in each process's working set (phase)
+    long long phase_length;  // requests before the working sets move (phase)
+    int *cursor;          // next page of each process (sequential, loop)
+    int *base;            // first page of each process's working set (phase)
+    double *zipf_cdf;     // cumulative probability of pages 0..pages-1 (zipf)
+} generator;
+
+// splitmix64, used to spread the seed over the generator state
+static uint64_t mix_seed(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// xorshift64*: fast and identical on every platform, unlike rand()
+static uint64_t next_random(generator *g) {
+    g->state ^= g->state >> 12;
+    g->state ^= g->state << 25;
+    g->state ^= g->state >> 27;
+    return g->state * 0x2545f4914f6cdd1dULL;
+}
+
+// Uniform integer in 0..n-1
+static int random_below(generator *g, int n) {
+    return (int)((next_random(g) >> 11) % (uint64_t)n);
+}
+
+// Uniform double in [0, 1)
+static double random_unit(generator *g) {
+    return (next_random(g) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Function to pick the page of process pid for the next request under the generator's pattern
+static int next_page(generator *g, int pid, long long step) {
+    switch (g->kind) {
+    case SEQUENTIAL: {
+        int page = g->cursor[pid];
+        g->cursor[pid] = (page + 1) % g->pages;
+        return page;
+    }
+    case LOOP: {
+        int page = g->cursor[pid];
+        g->cursor[pid] = (page + 1) % g->loop_length;
+        return page;
+    }
+    case UNIFORM:
+        return random_below(g, g->pages);
+    case ZIPF: {
+        // Binary search for the first page whose cumulative probability covers u
+        double u = random_unit(g);
+        int lo = 0, hi = g->pages - 1;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (g->zipf_cdf[mid] < u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+    case PHASE:
+        // Every phase_length requests each process moves to a new working set
+        if (step % g->phase_length == 0) {
+            for (int p = 0; p < g->processes; p++) {
+                g->base[p] = random_below(g, g->pages - g->working_set + 1);
+            }
+        }
+        return g->base[pid] + random_below(g, g->working_set);
+    default:
+        return 0;
+    }
+}
+
+// Function to prepare the per-pattern state; returns -1 when memory runs out
+static int init_generator(generator *g, double zipf_exponent) {
+    g->cursor = calloc(g->processes, sizeof(int));
+    g->base = calloc(g->processes, sizeof(int));
+    if (g->cursor == NULL || g->base == NULL) {
+        return -1;
+    }
+    if (g->kind == ZIPF) {
+        g->zipf_cdf = malloc(g->pages * sizeof(double));
+        if (g->zipf_cdf == NULL) {
+            return -1;
+        }
+        double sum = 0.0;
+        for (int k = 0; k < g->pages; k++) {
+            sum += 1.0 / pow(k + 1, zipf_exponent);
+            g->zipf_cdf[k] = sum;
+        }
+        for (int k = 0; k < g->pages; k++) {
+            g->zipf_cdf[k] /= sum;
+        }
+        g->zipf_cdf[g->pages - 1] = 1.0;  // Rounding must not leave a gap at the top
+    }
+    return 0;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s <pattern> <requests> <output_file|-> [options]\n", program);
+    fprintf(stderr, "  patterns: sequential, loop, uniform, zipf, phase\n");
+    fprintf(stderr, "  --processes N       number of processes (default %d)\n", PROCESSES);
+    fprintf(stderr, "  --pages N           pages per process (default %d)\n", PAGES_PER_PROCESS);
+    fprintf(stderr, "  --seed S            random seed (default 1)\n");
+    fprintf(stderr, "  --writes F          fraction of write records, 0..1 (default 0)\n");
+    fprintf(stderr, "  --loop N            pages in each loop (loop, default pages / 2)\n");
+    fprintf(stderr, "  --zipf S            Zipf exponent (zipf, default 1.0)\n");
+    fprintf(stderr, "  --working-set N     pages in each working set (phase, default pages / 8)\n");
+    fprintf(stderr, "  --phase N           requests between working-set moves (phase, default 10000)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    generator g = { 0 };
+    g.kind = PATTERN_COUNT;
+    for (int k = 0; k < PATTERN_COUNT; k++) {
+        if (strcmp(argv[1], pattern_names[k]) == 0) {
+            g.kind = k;
+        }
+    }
+    char *end;
+    long long requests = strtoll(argv[2], &end, 10);
+    if (g.kind == PATTERN_COUNT || *end != '\0' || requests < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    g.processes = PROCESSES;
+    g.pages = PAGES_PER_PROCESS;
+    unsigned long long seed = 1;
+    double zipf_exponent = 1.0;
+    g.loop_length = 0;
+    g.working_set = 0;
+    g.phase_length = 10000;
+
+    for (int i = 4; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = 1;
+        if (value == NULL) {
+            ok = 0;
+        } else if (strcmp(arg, "--processes") == 0) {
+            g.processes = (int)strtol(value, &end, 10);
+            ok = *end == '\0' && g.processes > 0;
+        } else if (strcmp(arg, "--pages") == 0) {
+            g.pages = (int)strtol(value, &end, 10);
+            ok = *end == '\0' && g.pages > 0;
+        } else if (strcmp(arg, "--seed") == 0) {
+            seed = strtoull(value, &end, 10);
+            ok = *end == '\0';
+        } else if (strcmp(arg, "--writes") == 0) {
+            g.write_ratio = strtod(value, &end);
+            ok = *end == '\0' && g.write_ratio >= 0.0 && g.write_ratio <= 1.0;
+        } else if (strcmp(arg, "--loop") == 0) {
+            g.loop_length = (int)strtol(value, &end, 10);
+            ok = *end == '\0' && g.loop_length > 0;
+        } else if (strcmp(arg, "--zipf") == 0) {
+            zipf_exponent = strtod(value, &end);
+            ok = *end == '\0' && zipf_exponent >= 0.0;
+        } else if (strcmp(arg, "--working-set") == 0) {
+            g.working_set = (int)strtol(value, &end, 10);
+            ok = *end == '\0' && g.working_set > 0;
+        } else if (strcmp(arg, "--phase") == 0) {
+            g.phase_length = strtoll(value, &end, 10);
+            ok = *end == '\0' && g.phase_length > 0;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid option %s %s\n", arg, value ? value : "");
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;  // Skip the option's value
+    }
+
+    if (g.loop_length == 0) {
+        g.loop_length = g.pages > 1 ? g.pages / 2 : 1;
+    }
+    if (g.working_set == 0) {
+        g.working_set = g.pages >= 8 ? g.pages / 8 : 1;
+    }
+    if (g.loop_length > g.pages || g.working_set > g.pages) {
+        fprintf(stderr, "--loop and --working-set cannot exceed --pages\n");
+        return EXIT_FAILURE;
+    }
+    g.state = mix_seed(seed);
+    if (g.state == 0) {
+        g.state = 1;
+    }
+    if (init_generator(&g, zipf_exponent) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *output_file = strcmp(argv[3], "-") == 0 ? stdout : fopen(argv[3], "w");
+    if (output_file == NULL) {
+        perror("Error opening output file");
+        return EXIT_FAILURE;
+    }
+    setvbuf(output_file, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+    // The header records everything needed to regenerate the trace
+    fprintf(output_file, "# tracegen %s requests=%lld processes=%d pages=%d seed=%llu writes=%g",
+            pattern_names[g.kind], requests, g.processes, g.pages, seed, g.write_ratio);
+    if (g.kind == LOOP) {
+        fprintf(output_file, " loop=%d", g.loop_length);
+    } else if (g.kind == ZIPF) {
+        fprintf(output_file, " zipf=%g", zipf_exponent);
+    } else if (g.kind == PHASE) {
+        fprintf(output_file, " working-set=%d phase=%lld", g.working_set, g.phase_length);
+    }
+    fprintf(output_file, "\n");
+
+    for (long long step = 0; step < requests; step++) {
+        int pid = random_below(&g, g.processes);
+        int page = next_page(&g, pid, step);
+        int write = g.write_ratio > 0.0 && random_unit(&g) < g.write_ratio;
+        fprintf(output_file, "%d %d %c\n", pid, page, write ? 'w' : 'r');
+    }
+
+    int status = EXIT_SUCCESS;
+    if (fflush(output_file) != 0 || ferror(output_file)) {
+        perror("Error writing output file");
+        status = EXIT_FAILURE;
+    }
+    if (output_file != stdout) {
+        fclose(output_file);
+    }
+    free(g.cursor);
+    free(g.base);
+    free(g.zipf_cdf);
+    return status;
+}